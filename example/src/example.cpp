@@ -15,18 +15,27 @@
 #define SAP_EXAMPLE_ABOUT  "Example application for SAP"
 
 #include <cmath> // pow
-#include <cstddef> // size_t
 #include <iostream> // std::cout, std::cerr
-#include <string> // std::string, std::stoll, std::stod
 
+#define SAP_IMPLEMENTATION // compile implementation into this file
 #include "sap.h" // include single header file
 
+// Callback fired by sap as soon as an operator is found, remembering which
+// one through data, so that we do not have to look at every operator after
+// parsing. Returning 1 would abort the parse.
+static int set_operator(const SapArgument *arg, const char *, int, void *data)
+{
+	*static_cast<unsigned int *>(data) = arg->shortopt;
+	return 0;
+}
+
 int main(int argc, char **argv) // get arguments the normal way
 {
 	// --- CONFIGURATION ---
-	SapConfig sap_config; // create a config struct to configure information
-	                      // about your application as well as the arguments you
-	                      // expect
+	SapConfig sap_config = {}; // create a config struct to configure
+	                           // information about your application as well as
+	                           // the arguments you expect, zeroing anything we
+	                           // do not use
 
 	// application information
 	sap_config.name = SAP_EXAMPLE_NAME; // name of application used when running
@@ -40,9 +49,9 @@ int main(int argc, char **argv) // get arguments the normal way
 	sap_config.about = SAP_EXAMPLE_ABOUT; // short description of application
 
 	// --- DEFINING ARGUMENTS ---
-	sap_config.argcount = 10; // number of possible arguments
-	SapArgument sap_args[sap_config.argcount]; // create an array of arguments
+	SapArgument sap_args[10] = {}; // create a zeroed array of arguments
 	sap_config.arguments = sap_args; // add array to configuration
+	sap_config.argcount = 10; // number of possible arguments
 
 	// When defining your arguments, you should fill out shortopt, longopt, help
 	// and type. After parsing, set and value will be written by SAP.
@@ -54,10 +63,9 @@ int main(int argc, char **argv) // get arguments the normal way
 	sap_args[0].type     = SAP_ARG_OPTION; // simple option
 	sap_args[0].required = 0; // optional option
 
-	// Optional options for mathematics. Ideally we would want to set exactly 1
-	// of these to be required, but this is not yet supported by SAP so we will
-	// have to do this by ourselves. We will be setting NONE of them to be
-	// required and validating afterwards.
+	// Optional options for mathematics. We want exactly 1 of these, which we
+	// will tell SAP with a rule below, so NONE of them are required on their
+	// own.
 
 	// add
 	sap_args[1].shortopt = 'a';
@@ -101,13 +109,20 @@ int main(int argc, char **argv) // get arguments the normal way
 	sap_args[6].type     = SAP_ARG_OPTION;
 	sap_args[6].required = 0;
 
-	// A required option with a value to determine what type of values we are
-	// using. -t int for integers and -t float for floating-point.
-	sap_args[7].shortopt = 't';
-	sap_args[7].longopt  = "type";
-	sap_args[7].help     = "[ int | float ] type of numbers";
-	sap_args[7].type     = SAP_ARG_OPTION_VALUE; // option with value
-	sap_args[7].required = 1; // make this compulsory
+	// An option with a value to determine what type of values we are using.
+	// -t int for integers and -t float for floating-point, integers if not
+	// given. Any other value fails the parse.
+	const int TYPE_INT = 0; // index into type_choices
+	const int TYPE_FLOAT = 1;
+	const char *const type_choices[] = { "int", "float" };
+	sap_args[7].shortopt      = 't';
+	sap_args[7].longopt       = "type";
+	sap_args[7].help          = "Type of numbers";
+	sap_args[7].type          = SAP_ARG_OPTION_VALUE; // option with value
+	sap_args[7].required      = 0; // optional, as we have a default
+	sap_args[7].default_value = "int"; // used if not given, shown in help
+	sap_args[7].choices       = type_choices; // allowed values, shown in help
+	sap_args[7].choicecount   = 2;
 
 	// Two compulsory positional arguments for our numbers
 	// sap_args[8].shortopt = ''; Note: No need for shortopt for positionals
@@ -120,69 +135,76 @@ int main(int argc, char **argv) // get arguments the normal way
 	sap_args[9].type     = SAP_ARG_POSITIONAL;
 	sap_args[9].required = 1;
 
+	// Have each operator tell us when it is found.
+	unsigned int op = 0; // short option of operator found
+	for (int i = 1; i <= 6; i++)
+	{
+		sap_args[i].callback      = set_operator; // fired on each match
+		sap_args[i].callback_data = &op; // passed to set_operator
+	}
+
+	// --- DEFINING RULES ---
+	// Rules constrain which arguments may be given together. Here exactly one
+	// of the operators (arguments 1 to 6) must be given.
+	const unsigned int operators[] = { 1, 2, 3, 4, 5, 6 };
+	SapRule sap_rules[1];
+	sap_rules[0].type       = SAP_RULE_EXACTLY_ONE; // exactly one of group
+	sap_rules[0].group      = operators; // indices into sap_args
+	sap_rules[0].groupcount = 6;
+	sap_config.rules     = sap_rules; // add rules to configuration
+	sap_config.rulecount = 1;
+
 	// --- PARSING ARGUMENTS ---
-	// Simply run sap_parse_args() to perform the parsing. It will return 1 if
-	// unsuccessful (e.g. if a required argument is missing). sap_args[0].set
-	// checks if -h asking for help has been set.
-	if (sap_parse_args(sap_config, argc, argv) || sap_args[0].set)
+	// Run sap_parse() to perform the parsing. It will return 1 if
+	// unsuccessful (e.g. if a required argument is missing, a rule is broken
+	// or -t is not one of its choices), and say why in sap_result.error, with
+	// the offending token and argument. sap_args[0].set checks if -h asking
+	// for help has been set. Every option / positional present will have .set
+	// set to 1, and will be 0 otherwise.
+	SapResult sap_result;
+	int invalid = sap_parse(sap_config, argc, argv, &sap_result);
+	if (sap_args[0].set)
 	{
-		sap_print_help(sap_config); // print help message if wrong
+		sap_print_help(sap_config); // print help message if asked for
 		return 1;
 	}
-
-	// Next let's check that exactly one of the operators has been chosen. Every
-	// option / positional present will have .set set to 1, and will be 0
-	// otherwise.
-	unsigned int operators_selected = 0;
-	for (size_t i = 1; i <= 6; i++) // iterate through operators
-		operators_selected += sap_args[i].set;
-	if (operators_selected != 1)
+	if (invalid)
 	{
-		std::cerr << "Use only one operator" << std::endl;
-		sap_print_help(sap_config);
+		sap_print_error(sap_config, &sap_result.error); // one line saying
+		                                                // what is wrong
 		return 1;
 	}
 
-	// Next, we check that the -t option is set to int or float and parse x
-	// and y, printing the help message if anything is invalid.
-	long long i_x, i_y; // ints for int mode
+	// To look at the results we can wrap them in a sap::results view, which
+	// finds arguments by short or long option and gives values as
+	// sap::string_view, without allocating anything.
+	sap::results results(sap_config, argc, argv);
+
+	// Next, we parse x and y according to -t, which the parse has already
+	// checked is one of its choices, printing the help message if anything
+	// is invalid.
+	long i_x, i_y; // ints for int mode
 	double lf_x, lf_y; // doubles for float mode
-	int type; // store which type we are using
-	const int TYPE_INT = 0;
-	const int TYPE_FLOAT = 1;
-	std::string type_opt = sap_args[7].value;
+	int type = results.choice('t'); // index into type_choices, or default's
+	int invalid_numbers;
 
-	try
+	// float mode
+	if (type == TYPE_FLOAT)
 	{
-		// check for int
-		if (type_opt == "int") // thanks std::string
-		{
-			// int mode
-			type = TYPE_INT;
-
-			// convert x and y to long long
-			i_x = std::stoll(sap_args[8].value);
-			i_y = std::stoll(sap_args[9].value);
-		}
-		// check for float
-		else if (type_opt == "float")
-		{
-			// float mode
-			type = TYPE_FLOAT;
-
-			// convert x and y to double
-			lf_x = std::stod(sap_args[8].value);
-			lf_y = std::stod(sap_args[9].value);
-		}
-		// invalid -t value
-		else
-		{
-			std::cerr << "Invalid type, use int or float" << std::endl;
-			sap_print_help(sap_config);
-			return 1;
-		}
+		// convert x and y to double, which returns 1 on failure
+		invalid_numbers = sap_get_double(results.find("x"), &lf_x)
+			|| sap_get_double(results.find("y"), &lf_y);
 	}
-	catch (const std::invalid_argument& e) // failed to parse x or y
+	// int mode
+	else
+	{
+		// convert x and y to long
+		invalid_numbers = sap_get_long(results.find("x"), &i_x)
+			|| sap_get_long(results.find("y"), &i_y);
+	}
+
+	// failed to parse x or y
+	if (invalid_numbers)
 	{
 		std::cerr << "Invalid numbers" << std::endl;
 		sap_print_help(sap_config);
@@ -193,41 +215,33 @@ int main(int argc, char **argv) // get arguments the normal way
 	// This part doesn't have much to do with SAP. Pretty much all we need SAP
 	// for has been completed.
 
-	// addition
-	if (sap_args[1].set)
+	switch (op) // operator found by set_operator
 	{
+	case 'a': // addition
 		if (type == TYPE_INT)
 			std::cout << i_x + i_y << std::endl;
 		else
 			std::cout << lf_x + lf_y << std::endl;
-	}
-	// subtraction
-	else if (sap_args[2].set)
-	{
+		break;
+	case 's': // subtraction
 		if (type == TYPE_INT)
 			std::cout << i_x - i_y << std::endl;
 		else
 			std::cout << lf_x - lf_y << std::endl;
-	}
-	// multiplication
-	else if (sap_args[3].set)
-	{
+		break;
+	case 'm': // multiplication
 		if (type == TYPE_INT)
 			std::cout << i_x * i_y << std::endl;
 		else
 			std::cout << lf_x * lf_y << std::endl;
-	}
-	// division
-	else if (sap_args[4].set)
-	{
+		break;
+	case 'd': // division
 		if (type == TYPE_INT)
 			std::cout << i_x / i_y << std::endl;
 		else
 			std::cout << lf_x / lf_y << std::endl;
-	}
-	// modulo
-	else if (sap_args[5].set)
-	{
+		break;
+	case 'M': // modulo
 		if (type == TYPE_INT)
 			std::cout << i_x % i_y << std::endl;
 		else
@@ -235,14 +249,13 @@ int main(int argc, char **argv) // get arguments the normal way
 			std::cerr << "Modulo not supported for floats" << std::endl;
 			return 1;
 		}
-	}
-	// exponent
-	else if (sap_args[6].set)
-	{
+		break;
+	case 'e': // exponent
 		if (type == TYPE_INT)
 			std::cout << round(pow(i_x, i_y)) << std::endl;
 		else
 			std::cout << pow(lf_x, lf_y) << std::endl;
+		break;
 	}
 
 	return 0;
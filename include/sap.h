@@ -16,15 +16,28 @@
 #define SAP_H_VERSION_CHECK(maj, min) \
 	((maj==MYLIB_MAJOR_VERSION) && (min<=MYLIB_MINOR_VERSION))
 
-// change headers depending on C/C++
+// change headers depending on C/C++, only those available without the C
+// library if SAP_FREESTANDING is defined
 #ifdef __cplusplus
-	#include <cctype>
-	#include <cstdio>
-	#include <cstring>
+	#include <cstddef>
+	#ifndef SAP_FREESTANDING
+		#include <cstdio>
+		#include <cstdlib>
+		#include <cstring>
+		#include <new>
+	#endif
+	#include <initializer_list>
+	#include <iterator>
+	#if __cplusplus >= 201703L
+		#include <string_view>
+	#endif
 #else
-	#include <ctype.h>
-	#include <stdio.h>
-	#include <string.h>
+	#include <stddef.h>
+	#ifndef SAP_FREESTANDING
+		#include <stdio.h>
+		#include <stdlib.h>
+		#include <string.h>
+	#endif
 #endif
 
 #ifndef DOXYGEN_IGNORE // exclude from documentation
@@ -32,8 +45,66 @@
 	#define ARG_LONGOPT 1
 	#define ARG_NORMAL 2
 	#define ARG_ERROR 3
+	#define ARG_END 4
+
+	#define SAP_ROLE_NONE 0
+	#define SAP_ROLE_OPTION 1
+	#define SAP_ROLE_VALUE 2
+	#define SAP_ROLE_POSITIONAL 3
+	#define SAP_ROLE_ERROR 4
+	#define SAP_ROLE_END 5
+
+	#define SAP_INCR_LABEL_STEP (1ULL << 32)
+
+	#define SAP_CHAR_ALPHA 0x01
+	#define SAP_CHAR_DIGIT 0x02
+	#define SAP_CHAR_CONT 0x04
+	#define SAP_CHAR_LEAD 0x08
+
+	#define SAP_WORD_BITS 64
+	#define SAP_WORDS(n) (((n) + SAP_WORD_BITS - 1) / SAP_WORD_BITS)
+
+	#define SAP_SHORT_TABLE 128
+
+	#define SAP_REGISTRY_ARGS 16
+	#define SAP_REGISTRY_TABLE 32
+	#define SAP_REGISTRY_CHUNK 1024
+
+	#define SAP_CHOICE_PENDING 0x80000000u
+	#define SAP_CHOICE_TRIES 64
+
+	#define SAP_RELOAD_SLOTS 4
+
+	#define SAP_PARALLEL_THREADS 64
+
+	#ifdef SAP_FREESTANDING
+		#define SAP_STRLEN _sap_strlen
+		#define SAP_STRCMP _sap_strcmp
+		#define SAP_STRNCMP _sap_strncmp
+		#define SAP_MEMCMP _sap_memcmp
+		#define SAP_MEMCPY _sap_memcpy
+		#define SAP_MEMMOVE _sap_memmove
+		#define SAP_MEMSET _sap_memset
+	#else
+		#define SAP_STRLEN strlen
+		#define SAP_STRCMP strcmp
+		#define SAP_STRNCMP strncmp
+		#define SAP_MEMCMP memcmp
+		#define SAP_MEMCPY memcpy
+		#define SAP_MEMMOVE memmove
+		#define SAP_MEMSET memset
+	#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
 #endif
 
+/**
+ * @brief Word used in bitsets over argument indices
+ */
+typedef unsigned long long SapWord;
+
 /**
  * @brief Enum describing argument type
  */
@@ -55,11 +126,53 @@ typedef enum SapArgumentType
 	SAP_ARG_POSITIONAL
 } SapArgumentType;
 
+/**
+ * @brief Flags changing how arguments are parsed
+ */
+typedef enum SapConfigFlag
+{
+	/**
+	 * @brief Treat tokens that look like negative numbers, such as -5 or
+	 * -1.5e3, as values and positional arguments rather than invalid options
+	 */
+	SAP_FLAG_NUMBERS = 1 << 0,
+
+	/**
+	 * @brief Stop looking for options at the first positional token, as
+	 * POSIX getopt() does, in addition to stopping at --
+	 */
+	SAP_FLAG_STOP = 1 << 1,
+
+	/**
+	 * @brief Fail on well-formed options not in the configuration with
+	 * SAP_ERROR_UNKNOWN, rather than ignoring them
+	 */
+	SAP_FLAG_STRICT = 1 << 2
+} SapConfigFlag;
+
+struct SapArgument;
+
+/**
+ * @brief Callback fired by a parse as soon as an argument is matched
+ *
+ * @param arg Argument matched, already with set, count and value updated
+ * @param value Value given, NULL for options without value
+ * @param position Index into argv of the token matched, the option itself for
+ * valued options
+ * @param data Pointer given with the callback
+ * @return 0 To carry on parsing
+ * @return 1 To abort the parse, which then fails
+ */
+typedef int (*SapCallback)(const struct SapArgument *arg, const char *value,
+	int position, void *data);
+
 /**
  * @brief Struct containing single argument configuration
  *
  * The application will set up shortopt, longopt, help and type, then set and
  * value will be set by sap_parse_args().
+ *
+ * Fields not used by the application must be zeroed.
  */
 typedef struct SapArgument
 {
@@ -98,12 +211,267 @@ typedef struct SapArgument
 
 	/**
 	 * @brief Value set for this argument
+	 *
+	 * Left untouched if the argument is not set, use sap_get_value() to fall
+	 * back to default_value.
 	 */
 	const char *value;
+
+	/**
+	 * @brief Will be set to the number of times argument has been provided,
+	 * counting each letter of short options given together, as in -vvv
+	 *
+	 * Always 1 for positional arguments that are set.
+	 */
+	unsigned int count;
+
+	/**
+	 * @brief Default value, NULL if none
+	 *
+	 * Never written into value, but returned by sap_get_value(),
+	 * sap_get_long() and sap_get_double() if the argument is not set.
+	 */
+	const char *default_value;
+
+	/**
+	 * @brief Values allowed for an option of type SAP_ARG_OPTION_VALUE,
+	 * NULL if any value is allowed
+	 *
+	 * A value not among them fails the parse. Looked up through a perfect
+	 * hash once the configuration is compiled with sap_compile(), and shown
+	 * by sap_print_help().
+	 */
+	const char *const *choices;
+
+	/**
+	 * @brief Number of values in choices
+	 */
+	unsigned int choicecount;
+
+	/**
+	 * @brief Will be set to the index into choices of value, if the
+	 * argument has choices and is set
+	 *
+	 * Left untouched if the argument is not set, use sap_get_choice() to
+	 * fall back to default_value.
+	 */
+	int choice;
+
+	/**
+	 * @brief Callback fired each time the argument is matched, before that
+	 * of the configuration, NULL if none
+	 *
+	 * Fired by sap_parse() and sap_parse_buffer(), so that handlers run in
+	 * argv order during the parse instead of in a walk over all arguments
+	 * after it.
+	 */
+	SapCallback callback;
+
+	/**
+	 * @brief Pointer passed to callback
+	 */
+	void *callback_data;
+
+	/**
+	 * @brief Index into sections of the configuration of the section an
+	 * option is listed under in help, ignored if it has no sections
+	 */
+	unsigned int section;
+
+	/**
+	 * @brief Short option beyond ASCII, a Unicode code point given in UTF-8
+	 * on the command line, used instead of shortopt if not 0
+	 */
+	unsigned int wideopt;
 } SapArgument;
 
+/**
+ * @brief Enum describing constraint type
+ */
+typedef enum SapRuleType
+{
+	/**
+	 * @brief Argument may not be given together with any of group
+	 */
+	SAP_RULE_CONFLICTS,
+
+	/**
+	 * @brief Argument may only be given together with all of group
+	 */
+	SAP_RULE_REQUIRES,
+
+	/**
+	 * @brief Exactly one of group must be given
+	 */
+	SAP_RULE_EXACTLY_ONE,
+
+	/**
+	 * @brief At least one of group must be given
+	 */
+	SAP_RULE_AT_LEAST_ONE
+} SapRuleType;
+
+/**
+ * @brief Struct containing a constraint between arguments
+ */
+typedef struct SapRule
+{
+	/**
+	 * @brief Type of constraint
+	 */
+	SapRuleType type;
+
+	/**
+	 * @brief Index of argument constrained, for SAP_RULE_CONFLICTS and
+	 * SAP_RULE_REQUIRES only
+	 */
+	unsigned int arg;
+
+	/**
+	 * @brief Indices of arguments in group
+	 */
+	const unsigned int *group;
+
+	/**
+	 * @brief Number of arguments in group
+	 */
+	unsigned int groupcount;
+} SapRule;
+
+/**
+ * @brief Struct containing a configuration compiled by sap_compile()
+ *
+ * Its contents are private to sap. Fields looked at for every token are kept
+ * in packed arrays apart from the argument records, so that a parse reads
+ * only the records of arguments given.
+ */
+typedef struct SapCompiled
+{
+	/** @private */
+	unsigned int words; // words per bitset
+
+	/** @private */
+	unsigned int tablemask; // size of longtable minus 1, a power of 2
+
+	/** @private */
+	unsigned int rulecount; // number of rules masks were built for
+
+	/** @private */
+	SapWord *masks; // required mask followed by one group mask per rule
+
+	/** @private */
+	unsigned int *shortopts; // shortopt of each argument, 0 if positional
+
+	/** @private */
+	unsigned int *hashes; // hash of longopt of each argument
+
+	/** @private */
+	unsigned int *lengths; // length of longopt of each argument
+
+	/** @private */
+	unsigned int *longtable; // argument index + 1 by longopt hash, 0 if empty
+
+	/** @private */
+	unsigned int *widetable; // argument index + 1 by hash of other
+	                         // shortopts, 0 if empty, size of longtable
+
+	/** @private */
+	unsigned int *shorttable; // argument index + 1 by ASCII shortopt
+
+	/** @private */
+	unsigned int *choiceoffsets; // offset + 1 of choice table by argument, 0
+	                             // if choices are searched in order
+
+	/** @private */
+	unsigned int *choicetables; // choice tables, each its slot mask, then
+	                            // one displacement per bucket, then choice
+	                            // index + 1 by slot, 0 if empty
+
+	/** @private */
+	unsigned char *types; // type of each argument
+} SapCompiled;
+
+/**
+ * @brief Struct describing one argument given, in command-line order
+ */
+typedef struct SapOccurrence
+{
+	/**
+	 * @brief Index of argument given, argcount for positional tokens beyond
+	 * the positional arguments configured
+	 */
+	unsigned int arg;
+
+	/**
+	 * @brief Value given, NULL for options without value
+	 */
+	const char *value;
+
+	/**
+	 * @brief Index into argv of the token, the option itself for valued
+	 * options
+	 */
+	int position;
+} SapOccurrence;
+
+/**
+ * @brief Preallocated array a parse writes every argument given into, in
+ * command-line order
+ */
+typedef struct SapStream
+{
+	/**
+	 * @brief Array to write occurrences into
+	 */
+	SapOccurrence *occurrences;
+
+	/**
+	 * @brief Number of occurrences that fit in occurrences
+	 */
+	unsigned int capacity;
+
+	/**
+	 * @brief Will be set to the number of occurrences found by the parse,
+	 * which may be more than capacity, in which case only the first capacity
+	 * are written
+	 */
+	unsigned int count;
+} SapStream;
+
+/**
+ * @brief Memory a parse copies values into, so that they outlive the
+ * command line they were parsed from
+ */
+typedef struct SapArena
+{
+	/**
+	 * @brief Memory to copy into, aligned for pointers
+	 */
+	void *memory;
+
+	/**
+	 * @brief Size of memory in bytes
+	 */
+	size_t size;
+
+	/**
+	 * @brief Will be set to the number of bytes the parse needed, copied
+	 * only if no more than size
+	 */
+	size_t used;
+
+	/**
+	 * @brief Whether the parse may grow memory with realloc() when it is too
+	 * small, in which case memory must come from malloc() or be NULL, and be
+	 * freed with free(); ignored with SAP_FREESTANDING
+	 */
+	int grow;
+} SapArena;
+
 /**
  * @brief Struct containing configuration of application and arguments
+ *
+ * Fields not used by the application must be zeroed.
  */
 typedef struct SapConfig
 {
@@ -146,263 +514,5535 @@ typedef struct SapConfig
 	 * @brief Number of argument configurations in arguments
 	 */
 	unsigned int argcount;
-} SapConfig;
 
-/**
- * @brief Parses arguments provided with the provided configuration, prints
- * help message if unsuccessful.
- *
- * Stores parsed argument values into config.
- *
- * @param config The SapConfig to use
- * @param argc Argument count
- * @param argv Argument values
- * @return 0 If arguments parsed succesfully
- * @return 1 If arguments were invalid
- */
-int sap_parse_args(SapConfig config, int argc, char **argv);
+	/**
+	 * @brief List of constraints between arguments
+	 */
+	SapRule *rules;
 
-/**
- * @brief Prints help message based on configuration
- *
- * @param config The SapConfig to use
- */
-void sap_print_help(SapConfig config);
+	/**
+	 * @brief Number of constraints in rules
+	 */
+	unsigned int rulecount;
 
-// checks argument type
-/** @private */
-int _sap_check_arg_type(char *arg)
-{
-	// flag
-	if (strlen(arg) >= 2 && arg[0] == '-')
-	{
-		// long option
-		if (arg[1] == '-') return ARG_LONGOPT;
+	/**
+	 * @brief Bitwise OR of SapConfigFlag values
+	 */
+	unsigned int flags;
 
-		// short options
-		if (isalpha(arg[1])) return ARG_SHORTOPT;
+	/**
+	 * @brief Compiled configuration set by sap_compile(), NULL if not
+	 * compiled
+	 *
+	 * Must be compiled again, or set to NULL, after arguments or rules
+	 * change. Only read by a parse, so that it may be shared by copies of
+	 * arguments and by threads.
+	 */
+	SapCompiled *compiled;
 
-		// unknown
-		else return ARG_ERROR;
-	}
-	// normal string
-	else
-		return ARG_NORMAL;
-}
+	/**
+	 * @brief Callback fired each time any argument is matched, after that of
+	 * the argument, NULL if none
+	 */
+	SapCallback callback;
 
-int sap_parse_args(SapConfig config, int argc, char **argv)
-{
-	// keep track of which tokens have been parsed
-	// we only update this for ARG_NORMAL arguments (since we want to keep track
-	// of which are positional and which are valued options
-	int parsed[argc]; // 0 = not parsed, 1 = parsed
-	for (int i = 0; i < argc; i++) parsed[i] = 0;
+	/**
+	 * @brief Pointer passed to callback
+	 */
+	void *callback_data;
 
-	// set all arguments to not set
-	for (unsigned int i = 0; i < config.argcount; i++)
-	{
-		config.arguments[i].set = 0;
-	}
+	/**
+	 * @brief Stream sap_parse() and sap_parse_buffer() write occurrences
+	 * into, NULL if none
+	 *
+	 * Each flag of short options given together, such as -ab, is an
+	 * occurrence of its own. Tokens of the tail are not occurrences.
+	 */
+	SapStream *stream;
 
-	// positionals handled so far
-	unsigned int positionalsHandled = 0;
+	/**
+	 * @brief Arena sap_parse(), sap_parse_buffer() and sap_cache_parse() copy
+	 * values into once done, NULL to leave them pointing into the command line
+	 *
+	 * Values of set arguments, occurrences written to stream and tokens of
+	 * the tail are copied together in one block, tail_argv as an array of
+	 * its own ending with NULL, so that the command line can be reused as
+	 * soon as the parse returns; it must not lie in the arena itself. The
+	 * parse fails, leaving values where they were, if the arena is too small
+	 * and cannot grow.
+	 */
+	SapArena *arena;
 
-	// iterate through the arguments we are looking for
-	for (unsigned int i = 0; i < config.argcount; i++)
-	{
-		SapArgument* arg = config.arguments + i;
+	/**
+	 * @brief Names of sections options are listed under in help, in order,
+	 * NULL to list them all under FLAGS
+	 */
+	const char *const *sections;
 
-		// check for flags
-		if (arg->type == SAP_ARG_OPTION || arg->type == SAP_ARG_OPTION_VALUE)
-		{
-			// iterate through arguments
-			for (int j = 1; j < argc; j++)
-			{
-				// check if option
-				int k, found = 0;
-				switch (_sap_check_arg_type(argv[j]))
-				{
-				case ARG_SHORTOPT: // short options
-					k = 1;
-					while (isalpha(argv[j][k]) && !found)
-					{
-						// found option
-						if (argv[j][k] == arg->shortopt)
-						{
-							arg->set = 1;
-							found = 1;
-
-							// check for value if necessary
-							if (arg->type == SAP_ARG_OPTION_VALUE)
-							{
-								if (j < argc - 1)
-								{
-									// too many options set for valued option
-									if (strlen(argv[j]) > 2)
-									{
-										return 1;
-									}
-
-									// get value and set next value to NIL
-									else if
-										(_sap_check_arg_type(argv[j + 1])
-											== ARG_NORMAL)
-									{
-										arg->value = argv[j + 1];
-										parsed[j + 1] = 1;
-									}
-									else // no value given
-									{
-										return 1;
-									}
-								}
-								else // no value given
-								{
-									return 1;
-								}
-							}
-						}
-
-						k++;
-					}
-					break;
-				case ARG_LONGOPT: // long option
-					if (strcmp(argv[j] + 2, arg->longopt) == 0)
-					{
-						arg->set = 1;
-						found = 1;
-
-						// check for value if necessary
-						if (arg->type == SAP_ARG_OPTION_VALUE)
-						{
-							if (j < argc - 1)
-							{
-								if (_sap_check_arg_type(argv[j + 1])
-									== ARG_NORMAL)
-								{
-									arg->value = argv[j + 1];
-									parsed[j + 1] = 1;
-								}
-							}
-							else
-							{
-								return 1; // no value given
-							}
-						}
-					}
-					break;
-				case ARG_ERROR: // error
-					return 1;
-				}
-			}
-		}
-	}
+	/**
+	 * @brief Number of names in sections
+	 */
+	unsigned int sectioncount;
 
-	for (unsigned int i = 0; i < config.argcount; i++)
-	{
-		SapArgument* arg = config.arguments + i;
+	/**
+	 * @brief Bitset of SAP_WORDS(argcount) words marking the arguments set
+	 * by the last parse of arguments, zeroed along with them, NULL if none
+	 *
+	 * A parse then clears set and count of only the arguments marked rather
+	 * than of all of them, which saves reading every record of large
+	 * configurations. It belongs with arguments, so that each copy of them
+	 * needs its own, and must be given to every parse of them.
+	 */
+	SapWord *setbits;
+} SapConfig;
 
-		// check for positionals
-		if (arg->type == SAP_ARG_POSITIONAL)
-		{
-			// positionals hit so far
-			unsigned int positionalsHit = 0;
+/**
+ * @brief Enum describing why a parse failed
+ */
+typedef enum SapErrorKind
+{
+	/**
+	 * @brief Parse succeeded
+	 */
+	SAP_ERROR_NONE,
 
-			// iterate through arguments
-			for (int j = 1; j < argc && arg->set == 0; j++)
-			{
-				// check if positional
-				switch (_sap_check_arg_type(argv[j]))
-				{
-				case ARG_NORMAL:
-					if (parsed[j]) break; // this was a valued option
-					if (positionalsHit == positionalsHandled)
-					{
-						arg->value = argv[j];
-						arg->set = 1;
-						positionalsHandled++;
-					}
-					else
-					{
-						positionalsHit++;
-					}
-					break;
-				case ARG_ERROR:
-					return 1;
-				}
-			}
-		}
-	}
+	/**
+	 * @brief Token is malformed as an option, such as -= or -1 without
+	 * SAP_FLAG_NUMBERS; well-formed options not in the configuration are
+	 * ignored, unless SAP_FLAG_STRICT is set
+	 */
+	SAP_ERROR_MALFORMED,
 
-	// check all required arguments are fulfilled
-	for (unsigned int i = 0; i < config.argcount; i++)
-	{
-		SapArgument* arg = config.arguments + i;
+	/**
+	 * @brief Valued option is not followed by a value
+	 */
+	SAP_ERROR_MISSING_VALUE,
 
-		// positional or required
-		if (arg->required || arg->type == SAP_ARG_POSITIONAL)
-		{
-			// not set
-			if (!arg->set)
-				return 1;
-		}
-	}
+	/**
+	 * @brief Valued short option is given among others in one token, or with
+	 * text after it
+	 */
+	SAP_ERROR_CLUSTER,
 
-	return 0;
-}
+	/**
+	 * @brief Value is given after '=' to an option that takes none
+	 */
+	SAP_ERROR_UNWANTED_VALUE,
+
+	/**
+	 * @brief Value is not one of the choices of its option
+	 */
+	SAP_ERROR_CHOICE,
+
+	/**
+	 * @brief Callback of an argument or of the configuration aborted the
+	 * parse
+	 */
+	SAP_ERROR_CALLBACK,
+
+	/**
+	 * @brief Required or positional argument is not given
+	 */
+	SAP_ERROR_REQUIRED,
+
+	/**
+	 * @brief Rule is broken
+	 */
+	SAP_ERROR_RULE,
+
+	/**
+	 * @brief Rule refers to a nonexistent argument
+	 */
+	SAP_ERROR_CONFIG,
+
+	/**
+	 * @brief Memory given to the parse is too small
+	 */
+	SAP_ERROR_MEMORY,
+
+	/**
+	 * @brief Well-formed option is not in the configuration, only with
+	 * SAP_FLAG_STRICT
+	 */
+	SAP_ERROR_UNKNOWN
+} SapErrorKind;
+
+/**
+ * @brief Struct describing why a parse failed, so that it can be reported
+ * without looking at the command line again
+ */
+typedef struct SapError
+{
+	/**
+	 * @brief Kind of error, SAP_ERROR_NONE if the parse succeeded
+	 */
+	SapErrorKind kind;
+
+	/**
+	 * @brief Index of offending token, into argv or among the tokens of the
+	 * buffer, -1 if the error is with no one token
+	 */
+	int token;
+
+	/**
+	 * @brief Offending token, or value for SAP_ERROR_CHOICE, pointing into
+	 * the command line, NULL if none
+	 */
+	const char *text;
+
+	/**
+	 * @brief Index of argument at fault, -1 if none; for SAP_ERROR_RULE, the
+	 * one of group given with SAP_RULE_CONFLICTS or missing with
+	 * SAP_RULE_REQUIRES
+	 */
+	int arg;
+
+	/**
+	 * @brief Index of rule broken for SAP_ERROR_RULE, -1 otherwise
+	 */
+	int rule;
+} SapError;
+
+/**
+ * @brief Struct containing what sap_parse() found besides argument values
+ */
+typedef struct SapResult
+{
+	/**
+	 * @brief Number of tokens left unparsed after the end of options
+	 */
+	int tail_argc;
+
+	/**
+	 * @brief Tokens left unparsed after the end of options, pointing into
+	 * argv, so that argv[argc] also ends tail_argv, NULL for
+	 * sap_parse_buffer()
+	 */
+	char **tail_argv;
+
+	/**
+	 * @brief Tokens left unparsed after the end of options by
+	 * sap_parse_buffer(), pointing into its buffer, NULL for sap_parse()
+	 */
+	const char *tail_buffer;
+
+	/**
+	 * @brief Size in bytes of tail_buffer
+	 */
+	size_t tail_size;
+
+	/**
+	 * @brief Why the parse failed, kind SAP_ERROR_NONE if it did not
+	 */
+	SapError error;
+} SapResult;
+
+/**
+ * @brief Struct changing an argument when rebuilding a command line with
+ * sap_build_argv()
+ */
+typedef struct SapOverride
+{
+	/**
+	 * @brief Index of argument to change
+	 */
+	unsigned int arg;
+
+	/**
+	 * @brief 1 to give the argument, 0 to leave it out
+	 */
+	int set;
+
+	/**
+	 * @brief Value to give valued options and positional arguments
+	 */
+	const char *value;
+} SapOverride;
+
+/**
+ * @brief Token slot used by the incremental parser
+ *
+ * Only text is of interest to the application, the remaining fields cache what
+ * the parser worked out about the token so that edits do not redo it.
+ */
+typedef struct SapIncrToken
+{
+	/**
+	 * @brief Token text
+	 */
+	const char *text;
+
+	/** @private */
+	unsigned long long label; // order label, increasing along the line
+
+	/** @private */
+	int kind; // ARG_* classification
+
+	/** @private */
+	int role; // SAP_ROLE_* the token currently plays
+
+	/** @private */
+	int arg; // argument the role refers to, -1 if none
+} SapIncrToken;
+
+/** @private */
+typedef struct SapIncrArg
+{
+	unsigned int count; // option tokens setting this argument
+	unsigned int values; // value tokens for this argument
+	unsigned long long holder; // label of the last value token
+} SapIncrArg;
+
+/** @private */
+typedef struct SapIncrPositional
+{
+	unsigned long long label; // label of positional token
+	const char *text; // text of positional token
+} SapIncrPositional;
+
+/**
+ * @brief State of an incremental parse of a single command line
+ *
+ * Set up with sap_incr_init(), then edited with sap_incr_insert(),
+ * sap_incr_remove() and sap_incr_replace(). After every edit, set and value of
+ * the configuration's arguments are as sap_parse_args() would leave them for
+ * the current tokens, and sap_incr_status() gives its return value.
+ *
+ * Tokens do not include the program name, i.e. token 0 corresponds to argv[1].
+ */
+typedef struct SapIncremental
+{
+	/**
+	 * @brief The SapConfig results are written into
+	 */
+	SapConfig config;
+
+	/**
+	 * @brief Tokens of the command line
+	 */
+	SapIncrToken *tokens;
+
+	/**
+	 * @brief Number of tokens in the command line
+	 */
+	unsigned int count;
+
+	/**
+	 * @brief Maximum number of tokens
+	 */
+	unsigned int capacity;
+
+	/** @private */
+	SapIncrArg *args; // per argument state
+
+	/** @private */
+	SapIncrPositional *positionals; // first posargcount positional tokens
+
+	/** @private */
+	SapWord *masks; // masks of constraints, as in SapCompiled
+
+	/** @private */
+	SapWord *set; // bitset of arguments set
+
+	/** @private */
+	unsigned int *posargs; // indices of positional arguments
+
+	/** @private */
+	unsigned int posargcount; // number of positional arguments
+
+	/** @private */
+	unsigned int poscount; // number of positional tokens
+
+	/** @private */
+	unsigned int errors; // number of tokens in error
+
+	/** @private */
+	unsigned int missing; // number of required arguments not set
+
+	/** @private */
+	unsigned int end; // index of token ending options, count if none
+} SapIncremental;
+
+/** @private */
+typedef struct SapRegistryChunk
+{
+	struct SapRegistryChunk *next; // chunk allocated before this one
+	size_t size; // bytes of strings this chunk holds
+	size_t used; // bytes of strings in use
+} SapRegistryChunk;
+
+/**
+ * @brief Configuration built up one argument at a time
+ *
+ * Set up with sap_registry_init(), added to with sap_config_add() and freed
+ * with sap_registry_free(). Arguments are appended to an array growing
+ * geometrically and their strings are copied into chunks that never move, so
+ * that adding n arguments costs O(n) overall.
+ */
+typedef struct SapRegistry
+{
+	/**
+	 * @brief The configuration built, to be passed to sap functions
+	 *
+	 * arguments moves as it grows, so arguments are best referred to by
+	 * index. It is kept compiled, and with setbits, as arguments are added,
+	 * so that it parses as fast as one compiled with sap_compile(). Rules
+	 * are not compiled, and parsing with rules set fails with
+	 * SAP_ERROR_CONFIG, so set them on a copy and compile that instead.
+	 * What it points to is allocated, so the registry may be moved.
+	 */
+	SapConfig config;
+
+	/** @private */
+	unsigned int capacity; // arguments there is room for
+
+	/** @private */
+	SapRegistryChunk *chunks; // chunk strings are being copied into
+} SapRegistry;
+
+/** @private */
+typedef struct SapCacheRecord
+{
+	unsigned int arg; // index of argument set
+	unsigned int count; // number of times it is given
+	int token; // index into argv of its value, -1 if none
+	unsigned int offset; // offset of its value into the token
+	int choice; // index of its value into choices
+} SapCacheRecord;
+
+/** @private */
+typedef struct SapCacheEntry
+{
+	unsigned long long hash; // hash of tokens after argv[0]
+	int argc; // argument count
+	int tail_argc; // number of tokens in tail
+	unsigned int textsize; // bytes of tokens, including NULs
+	unsigned int recordcount; // number of arguments set
+	unsigned int prev; // entry used more recently, capacity if none
+	unsigned int next; // entry used less recently, capacity if none
+	unsigned int chain; // next entry with same bucket, capacity if none
+} SapCacheEntry;
+
+/**
+ * @brief Cache of results of parsing command lines seen before
+ *
+ * Set up with sap_cache_init(), then used with sap_cache_parse() in place of
+ * sap_parse(). Valid command lines are remembered by the hash of their tokens,
+ * with values stored as positions in argv, so that a later command line with
+ * the same tokens in another buffer costs one hash and one compare. The least
+ * recently used command line is forgotten when the cache is full.
+ */
+typedef struct SapCache
+{
+	/**
+	 * @brief The SapConfig results are written into
+	 */
+	SapConfig config;
+
+	/**
+	 * @brief Number of command lines found in the cache
+	 */
+	unsigned long long hits;
+
+	/**
+	 * @brief Number of command lines parsed in full
+	 */
+	unsigned long long misses;
+
+	/**
+	 * @brief Number of valid command lines parsed in full that could not be
+	 * remembered, as they set more arguments than there are records for
+	 */
+	unsigned long long unstored;
+
+	/** @private */
+	SapCacheEntry *entries; // command lines remembered
+
+	/** @private */
+	SapCacheRecord *records; // maxrecords arguments set per entry
+
+	/** @private */
+	unsigned int *buckets; // first entry by hash, capacity if none
+
+	/** @private */
+	char *text; // maxbytes bytes of tokens per entry
+
+	/** @private */
+	unsigned int capacity; // number of entries
+
+	/** @private */
+	unsigned int used; // number of entries in use
+
+	/** @private */
+	unsigned int bucketmask; // number of buckets minus 1, a power of 2
+
+	/** @private */
+	unsigned int maxbytes; // bytes of tokens per entry
+
+	/** @private */
+	unsigned int maxrecords; // arguments set per entry
+
+	/** @private */
+	unsigned int head; // entry used most recently, capacity if none
+
+	/** @private */
+	unsigned int tail; // entry used least recently, capacity if none
+
+	/** @private */
+	int full; // whether to parse in full, as a hit can neither fire
+	          // callbacks nor fill a stream
+} SapCache;
+
+/** @private */
+typedef struct SapKeyword
+{
+	const char *word; // start of word, in a long option or help message
+	unsigned int length; // length of word in bytes
+	unsigned int arg; // argument the word belongs to
+} SapKeyword;
+
+/**
+ * @brief Index of help messages by section and by keyword
+ *
+ * Set up with sap_help_index_init() in memory provided. Options are listed
+ * by section, and words of long options and help messages sorted, so that
+ * writing one section or the arguments matching a keyword takes time in what
+ * is written rather than in the size of the configuration.
+ */
+typedef struct SapHelpIndex
+{
+	/**
+	 * @brief The SapConfig indexed
+	 */
+	SapConfig config;
+
+	/** @private */
+	SapKeyword *keywords; // sorted by word ignoring ASCII case, then by
+	                      // argument, each pair once
+
+	/** @private */
+	unsigned int keywordcount; // number of keywords
+
+	/** @private */
+	unsigned int *order; // options by section in order of arguments, then
+	                     // positional arguments
+
+	/** @private */
+	unsigned int *starts; // start of each section in order, then of
+	                      // positional arguments, then argcount
+} SapHelpIndex;
+
+/**
+ * @brief Parses arguments provided with the provided configuration, prints
+ * help message if unsuccessful.
+ *
+ * Stores parsed argument values into config. Same as sap_parse() without a
+ * result, so any tokens after the end of options are dropped.
+ *
+ * @param config The SapConfig to use
+ * @param argc Argument count
+ * @param argv Argument values
+ * @return 0 If arguments parsed succesfully
+ * @return 1 If arguments were invalid
+ */
+int sap_parse_args(SapConfig config, int argc, char **argv);
+
+/**
+ * @brief Parses arguments provided with the provided configuration
+ *
+ * Stores parsed argument values into config. Options end at a -- token, or
+ * with SAP_FLAG_STOP at the first positional token. Positional arguments not
+ * yet set are then taken from the tokens that follow, and the rest are left
+ * unparsed as the tail, so that they can be handed to another program as
+ * they are.
+ *
+ * @param config The SapConfig to use
+ * @param argc Argument count
+ * @param argv Argument values
+ * @param result Where to store the tail and any error, may be NULL
+ * @return 0 If arguments parsed succesfully
+ * @return 1 If arguments were invalid
+ */
+int sap_parse(SapConfig config, int argc, char **argv, SapResult *result);
+
+/**
+ * @brief Gets size of memory needed by sap_parse_parallel()
+ *
+ * @param argc Argument count
+ * @return Size in bytes
+ */
+size_t sap_parse_parallel_size(int argc);
+
+/**
+ * @brief Parses arguments as sap_parse(), classifying tokens on several
+ * threads
+ *
+ * Tokens are split into one chunk per thread, each classified and looked up
+ * among the arguments on its own thread, reading the token before the chunk
+ * to tell values of options at its start. Only this classification runs in
+ * parallel: matching tokens to arguments, setting them and checking
+ * constraints then happen in order on the calling thread, so that results,
+ * callbacks and the stream are the same as those of sap_parse(). Threads are
+ * only started on Linux where SAP_THREADS is defined along with
+ * SAP_IMPLEMENTATION, which needs linking with -pthread, and not with
+ * SAP_FREESTANDING; otherwise the whole parse runs serially on the calling
+ * thread, classifying chunks in turn.
+ *
+ * @param config The SapConfig to use, compiled for speed
+ * @param argc Argument count
+ * @param argv Argument values
+ * @param result Where to store the tail and any error, may be NULL
+ * @param threads Number of threads to classify with, counting the calling one,
+ * at most 64
+ * @param memory Memory of at least sap_parse_parallel_size() bytes, aligned
+ * for ints
+ * @param size Size of memory
+ * @return 0 If arguments parsed succesfully
+ * @return 1 If arguments were invalid or memory is too small
+ */
+int sap_parse_parallel(SapConfig config, int argc, char **argv,
+	SapResult *result, unsigned int threads, void *memory, size_t size);
+
+/**
+ * @brief Parses arguments given as a buffer of NUL-terminated tokens, such as
+ * /proc/<pid>/cmdline, as sap_parse()
+ *
+ * Values point into buffer, nothing is copied.
+ *
+ * @param config The SapConfig to use
+ * @param buffer Tokens, argv[0] first, each followed by NUL
+ * @param size Size of buffer in bytes, whose last byte must be NUL
+ * @param result Where to store the tail and any error, may be NULL
+ * @return 0 If arguments parsed succesfully
+ * @return 1 If arguments were invalid
+ */
+int sap_parse_buffer(SapConfig config, const char *buffer, size_t size,
+	SapResult *result);
+
+/**
+ * @brief Gets size of memory needed by sap_build_argv()
+ *
+ * @param config The SapConfig parsed into
+ * @param argv0 First token of the command line
+ * @param result Result of the parse, for its tail, may be NULL
+ * @param overrides Changes to arguments, may be NULL if overridecount is 0
+ * @param overridecount Number of changes in overrides
+ * @return Size in bytes
+ */
+size_t sap_build_argv_size(SapConfig config, const char *argv0,
+	const SapResult *result, const SapOverride *overrides,
+	unsigned int overridecount);
+
+/**
+ * @brief Rebuilds a canonical command line from arguments set by a parse, with
+ * changes, into one block of memory
+ *
+ * Options set are given first in the order of config.arguments, each by its
+ * long option or else its short option, flags as many times as they were
+ * counted and valued options once with their value, attached after '=' if it
+ * looks like an option itself. Positional arguments follow, then the tail,
+ * with -- before them if there is a tail or a positional value looks like an
+ * option. The pointer array and all strings are copied into memory, so that
+ * freeing memory frees the command line.
+ *
+ * @param config The SapConfig parsed into
+ * @param argv0 First token of the command line
+ * @param result Result of the parse, for its tail, may be NULL
+ * @param overrides Changes to arguments, applied in place of what the parse
+ * set without changing config, may be NULL if overridecount is 0
+ * @param overridecount Number of changes in overrides
+ * @param memory Memory of at least sap_build_argv_size() bytes, aligned for
+ * pointers
+ * @param size Size of memory
+ * @param argc Where to store the number of tokens, may be NULL
+ * @return Tokens, ending with NULL, pointing into memory, NULL if memory is
+ * too small or an option cannot be given, having no value, neither long nor
+ * short option, or a value looking like an option and no long option
+ */
+char **sap_build_argv(SapConfig config, const char *argv0,
+	const SapResult *result, const SapOverride *overrides,
+	unsigned int overridecount, void *memory, size_t size, int *argc);
+
+#if defined(__linux__) && !defined(SAP_FREESTANDING)
+/**
+ * @brief Function called by sap_proc_sweep() for every process
+ *
+ * @param pid Process ID
+ * @param status Return value of sap_parse_buffer() for its command line
+ * @param result Tail of its command line
+ * @param cmdline Its command line, NUL-separated
+ * @param size Size of cmdline in bytes
+ * @param data Data passed to sap_proc_sweep()
+ * @return 0 To carry on with the sweep, anything else to stop it
+ */
+typedef int (*SapProcCallback)(int pid, int status, const SapResult *result,
+	const char *cmdline, size_t size, void *data);
+
+/**
+ * @brief Parses command line of every process in /proc with config
+ *
+ * Every command line is read into buffer in turn and parsed there, so that
+ * the sweep allocates nothing beyond the directory stream. Command lines
+ * longer than buffer are cut short, and processes without one, such as kernel
+ * threads, are skipped. Linux only.
+ *
+ * @param config The SapConfig to use, compiled for speed
+ * @param buffer Buffer to read command lines into
+ * @param size Size of buffer in bytes, at least 2
+ * @param callback Function called with results of every process
+ * @param data Data passed on to callback
+ * @return 0 If /proc was swept
+ * @return 1 If /proc could not be read or buffer is too small
+ */
+int sap_proc_sweep(SapConfig config, char *buffer, size_t size,
+	SapProcCallback callback, void *data);
+
+/**
+ * @brief Results of one load of a file watched by a SapReloader
+ *
+ * Stays unchanged while held through sap_reload_acquire(), however often the
+ * file is loaded again meanwhile.
+ */
+typedef struct SapSnapshot
+{
+	/** @brief Copy of config arguments, set and valued as parsed from file */
+	const SapArgument *arguments;
+	/** @brief Number of arguments */
+	unsigned int argcount;
+	/** @brief Number of the load, counting from 1 */
+	unsigned long long generation;
+
+	/** @private */
+	SapArgument *args; // owned arguments, the same as arguments
+	/** @private */
+	char *buffer; // tokens of the file, values point into them
+	/** @private */
+	size_t buffersize; // capacity of buffer
+	/** @private */
+	unsigned int readers; // threads holding the snapshot
+} SapSnapshot;
+
+/**
+ * @brief Function called by sap_reload_poll() for every argument the new
+ * load of the file changed
+ *
+ * @param i Index of the argument
+ * @param old The argument as it was, in the previous snapshot
+ * @param now The argument as it is, in the current snapshot
+ * @param data Data passed to sap_reload_init()
+ */
+typedef void (*SapReloadCallback)(unsigned int i, const SapArgument *old,
+	const SapArgument *now, void *data);
+
+/**
+ * @brief Watches a file of options and parses it again when it changes
+ *
+ * Readers take the current results with sap_reload_acquire() from any thread
+ * without locking, while one thread calls sap_reload_poll(). Initialised by
+ * sap_reload_init(), freed by sap_reload_free().
+ */
+typedef struct SapReloader
+{
+	/** @brief Configuration the file is parsed with, arguments are copied */
+	SapConfig config;
+	/** @brief Path of the watched file */
+	const char *path;
+	/** @brief Function called with changed arguments, may be NULL */
+	SapReloadCallback callback;
+	/** @brief Data passed on to callback */
+	void *data;
+	/** @brief Inotify descriptor, readable when sap_reload_poll() has work */
+	int fd;
+
+	/** @private */
+	SapSnapshot slots[SAP_RELOAD_SLOTS]; // ring the current snapshot moves in
+	/** @private */
+	unsigned long long current; // generation << 8 | slot
+	/** @private */
+	int pending; // file changed but was not loaded yet
+} SapReloader;
+
+/**
+ * @brief Loads file of options and starts watching it
+ *
+ * The file holds tokens as they would appear on a command line, separated by
+ * whitespace, with # commenting out the rest of a line; there is no quoting.
+ * The directory of the file is watched rather than the file, so that editors
+ * replacing it by renaming are followed. The reloader must be freed with
+ * sap_reload_free() even if this fails. Linux only.
+ *
+ * @param reloader The SapReloader to initialise
+ * @param config The SapConfig to parse with, kept by reference
+ * @param path Path of the file, kept by reference
+ * @param callback Function called with changed arguments, may be NULL
+ * @param data Data passed on to callback
+ * @return 0 If the file was loaded and is watched
+ * @return 1 If the file could not be read or parsed, or watched
+ */
+int sap_reload_init(SapReloader *reloader, SapConfig config, const char *path,
+	SapReloadCallback callback, void *data);
+
+/**
+ * @brief Loads the file again if it changed, without blocking
+ *
+ * The new results are swapped in atomically and arguments that differ from
+ * the previous load, in whether they are set, their count or value, are then
+ * passed to the callback. Readers keep the snapshot they hold. Call it from
+ * one thread only, for example when reloader->fd becomes readable.
+ *
+ * @param reloader The SapReloader to poll
+ * @return 0 If the file is unchanged or was loaded again
+ * @return 1 If the file could not be read or parsed, keeping the previous
+ * results, or every spare snapshot is held, leaving the load to the next call
+ */
+int sap_reload_poll(SapReloader *reloader);
+
+/**
+ * @brief Takes the current results, lock free
+ *
+ * @param reloader The SapReloader to read
+ * @return Current snapshot, unchanged until given to sap_reload_release()
+ */
+const SapSnapshot *sap_reload_acquire(SapReloader *reloader);
+
+/**
+ * @brief Gives back a snapshot taken with sap_reload_acquire()
+ *
+ * @param snapshot The snapshot to give back
+ */
+void sap_reload_release(const SapSnapshot *snapshot);
+
+/**
+ * @brief Stops watching and frees snapshots, none of which may still be held
+ *
+ * @param reloader The SapReloader to free
+ */
+void sap_reload_free(SapReloader *reloader);
+#endif
+
+/**
+ * @brief Callback receiving help message as it is written
+ *
+ * @param text Text to write, not NUL-terminated
+ * @param size Size in bytes of text
+ * @param data Pointer passed to sap_write_help()
+ */
+typedef void (*SapWriteCallback)(const char *text, size_t size, void *data);
+
+/**
+ * @brief Writes help message based on configuration through callback, without
+ * stdio, piece by piece
+ *
+ * @param config The SapConfig to use
+ * @param write Callback to write each piece of the message
+ * @param data Pointer passed on to write
+ */
+void sap_write_help(SapConfig config, SapWriteCallback write, void *data);
+
+#ifndef SAP_FREESTANDING
+/**
+ * @brief Prints help message based on configuration to stdout
+ *
+ * Not available if SAP_FREESTANDING is defined, use sap_write_help() instead.
+ *
+ * @param config The SapConfig to use
+ */
+void sap_print_help(SapConfig config);
+#endif
+
+/**
+ * @brief Writes one line describing the error of a failed parse through
+ * callback, prefixed with the name of the application
+ *
+ * Nothing is written for SAP_ERROR_NONE.
+ *
+ * @param config The SapConfig parsed with
+ * @param error Error of the parse, from its SapResult
+ * @param write Callback to write with
+ * @param data Pointer passed to write
+ */
+void sap_write_error(SapConfig config, const SapError *error,
+	SapWriteCallback write, void *data);
+
+#ifndef SAP_FREESTANDING
+/**
+ * @brief Prints line describing the error of a failed parse to stderr
+ *
+ * Not available if SAP_FREESTANDING is defined, use sap_write_error()
+ * instead.
+ *
+ * @param config The SapConfig parsed with
+ * @param error Error of the parse, from its SapResult
+ */
+void sap_print_error(SapConfig config, const SapError *error);
+#endif
+
+/**
+ * @brief Gets size of memory needed by sap_help_index_init()
+ *
+ * @param config The SapConfig to index
+ * @return Size in bytes
+ */
+size_t sap_help_index_size(SapConfig config);
+
+/**
+ * @brief Indexes help messages of configuration by section and by keyword
+ *
+ * Keywords are the words of long options and help messages, runs of letters,
+ * digits and UTF-8 sequences, as well as whole long options made of several
+ * words. Strings are not copied, so the configuration must outlive the index.
+ *
+ * @param index The SapHelpIndex to initialise
+ * @param config The SapConfig to index
+ * @param memory Memory of at least sap_help_index_size() bytes, aligned for
+ * pointers, to be kept alive while index is in use
+ * @param size Size of memory
+ * @return 0 If indexed succesfully
+ * @return 1 If memory is too small or an option is in a nonexistent section
+ */
+int sap_help_index_init(SapHelpIndex *index, SapConfig config, void *memory,
+	size_t size);
+
+/**
+ * @brief Writes help of the options in one section through callback, as
+ * listed by sap_write_help(), under the name of the section
+ *
+ * @param index The SapHelpIndex to write from
+ * @param section Name of section
+ * @param write Callback to write with
+ * @param data Pointer passed to write
+ * @return 0 If written succesfully
+ * @return 1 If there is no section of that name
+ */
+int sap_write_help_section(const SapHelpIndex *index, const char *section,
+	SapWriteCallback write, void *data);
+
+/**
+ * @brief Writes help of the arguments with a keyword through callback, one
+ * line each in order of arguments, as listed by sap_write_help()
+ *
+ * @param index The SapHelpIndex to write from
+ * @param keyword Word to look for, ignoring ASCII case and leading dashes
+ * @param write Callback to write with
+ * @param data Pointer passed to write
+ * @return Number of arguments written
+ */
+unsigned int sap_write_help_keyword(const SapHelpIndex *index,
+	const char *keyword, SapWriteCallback write, void *data);
+
+#ifndef SAP_FREESTANDING
+/**
+ * @brief Prints help of the options in one section to stdout, as
+ * sap_write_help_section()
+ *
+ * @param index The SapHelpIndex to print from
+ * @param section Name of section
+ * @return 0 If printed succesfully
+ * @return 1 If there is no section of that name
+ */
+int sap_print_help_section(const SapHelpIndex *index, const char *section);
+
+/**
+ * @brief Prints help of the arguments with a keyword to stdout, as
+ * sap_write_help_keyword()
+ *
+ * @param index The SapHelpIndex to print from
+ * @param keyword Word to look for, ignoring ASCII case and leading dashes
+ * @return Number of arguments printed
+ */
+unsigned int sap_print_help_keyword(const SapHelpIndex *index,
+	const char *keyword);
+#endif
+
+/**
+ * @brief Gets value of argument, or its default value if not set
+ *
+ * @param arg The SapArgument to get value of
+ * @return Value, NULL if neither set nor with a default value
+ */
+const char *sap_get_value(const SapArgument *arg);
+
+/**
+ * @brief Gets value of argument, or its default value if not set, as an
+ * integer
+ *
+ * Conversion is only done on access, so that arguments never looked at cost
+ * nothing.
+ *
+ * @param arg The SapArgument to get value of
+ * @param out Converted value
+ * @return 0 If converted succesfully
+ * @return 1 If there is no value, it is not an integer or it is out of the
+ * range of long
+ */
+int sap_get_long(const SapArgument *arg, long *out);
+
+#ifndef SAP_FREESTANDING
+/**
+ * @brief Gets value of argument, or its default value if not set, as a
+ * floating point number
+ *
+ * Not available if SAP_FREESTANDING is defined.
+ *
+ * @param arg The SapArgument to get value of
+ * @param out Converted value
+ * @return 0 If converted succesfully
+ * @return 1 If there is no value, it is not a number or it is out of the
+ * range of double
+ */
+int sap_get_double(const SapArgument *arg, double *out);
+#endif
+
+/**
+ * @brief Gets index into choices of value of argument, or of its default value
+ * if not set
+ *
+ * @param arg The SapArgument to get choice of
+ * @return Index into choices, -1 if there is no value or it is not a choice
+ */
+int sap_get_choice(const SapArgument *arg);
+
+/**
+ * @brief Finds choices of argument starting with prefix, for completion
+ *
+ * @param arg The SapArgument to complete value of
+ * @param prefix Start of value typed so far
+ * @param out Array to write up to max matching choices into, in order of
+ * choices, may be NULL if max is 0
+ * @param max Size of out
+ * @return Number of matching choices, which may be more than max
+ */
+unsigned int sap_complete_choices(const SapArgument *arg, const char *prefix,
+	const char **out, unsigned int max);
+
+/**
+ * @brief Gets size of memory needed by sap_compile()
+ *
+ * @param config The SapConfig to compile
+ * @return Size in bytes
+ */
+size_t sap_compile_size(SapConfig config);
+
+/**
+ * @brief Compiles configuration for faster parsing
+ *
+ * Constraints in rules are compiled into bitsets over argument indices, so
+ * that checking them after a parse takes a few word operations per rule.
+ * Options are looked up through hash tables instead of by scanning the
+ * arguments, and values of options with choices through a perfect hash built
+ * for each of them. Uncompiled configurations are still parsed correctly, but
+ * compile the rules on every parse.
+ *
+ * @param config The SapConfig to compile, config->compiled is set on success
+ * @param memory Memory of at least sap_compile_size() bytes, to be kept alive
+ * as long as config->compiled is in use
+ * @param size Size of memory
+ * @return 0 If compiled succesfully
+ * @return 1 If memory is too small or a rule refers to a nonexistent argument
+ */
+int sap_compile(SapConfig *config, void *memory, size_t size);
+
+/**
+ * @brief Gets size of memory needed by sap_incr_init()
+ *
+ * @param config The SapConfig to use
+ * @param capacity Maximum number of tokens
+ * @return Size in bytes
+ */
+size_t sap_incr_size(SapConfig config, unsigned int capacity);
+
+/**
+ * @brief Sets up an empty incremental parse
+ *
+ * @param state State to set up
+ * @param config The SapConfig to use
+ * @param memory Memory of at least sap_incr_size() bytes, to be kept alive as
+ * long as state is in use
+ * @param size Size of memory
+ * @param capacity Maximum number of tokens
+ * @return 0 If set up succesfully
+ * @return 1 If memory is too small or a rule refers to a nonexistent argument
+ */
+int sap_incr_init(SapIncremental *state, SapConfig config, void *memory,
+	size_t size, unsigned int capacity);
+
+/**
+ * @brief Inserts a token before the token at index
+ *
+ * @param state The SapIncremental to edit
+ * @param index Position of new token, up to and including state->count
+ * @param token Token to insert, to be kept alive while it is in state
+ * @return 0 If inserted succesfully
+ * @return 1 If index is out of range or state is full
+ */
+int sap_incr_insert(SapIncremental *state, unsigned int index,
+	const char *token);
+
+/**
+ * @brief Removes the token at index
+ *
+ * @param state The SapIncremental to edit
+ * @param index Position of token to remove
+ * @return 0 If removed succesfully
+ * @return 1 If index is out of range
+ */
+int sap_incr_remove(SapIncremental *state, unsigned int index);
+
+/**
+ * @brief Replaces the token at index
+ *
+ * @param state The SapIncremental to edit
+ * @param index Position of token to replace
+ * @param token New token, to be kept alive while it is in state
+ * @return 0 If replaced succesfully
+ * @return 1 If index is out of range
+ */
+int sap_incr_replace(SapIncremental *state, unsigned int index,
+	const char *token);
+
+/**
+ * @brief Gets whether the current tokens form a valid command line
+ *
+ * @param state The SapIncremental to check
+ * @return 0 If arguments are valid
+ * @return 1 If arguments are invalid
+ */
+int sap_incr_status(const SapIncremental *state);
+
+#ifndef SAP_FREESTANDING
+/**
+ * @brief Initialises registry with metadata of config and copies of its
+ * arguments
+ *
+ * The registry must be freed with sap_registry_free() even if this fails. Not
+ * available if SAP_FREESTANDING is defined, as the registry allocates.
+ *
+ * @param registry The SapRegistry to initialise
+ * @param config Configuration to start from, rules are not copied
+ * @return 0 If initialised succesfully
+ * @return 1 If out of memory or config has repeated options
+ */
+int sap_registry_init(SapRegistry *registry, SapConfig config);
+
+/**
+ * @brief Adds copy of argument to registry
+ *
+ * Positional arguments are parsed in the order they are added.
+ *
+ * @param registry The SapRegistry to add to
+ * @param group Namespace of argument, NULL if none, otherwise longopt, if
+ * any, is prefixed by group and a dot
+ * @param argument Argument to copy, with strings and choices copied too
+ * @return Index of argument in registry->config.arguments, -1 if out of memory
+ * or its long or short option is already taken
+ */
+int sap_config_add(SapRegistry *registry, const char *group,
+	const SapArgument *argument);
+
+/**
+ * @brief Finds argument of registry by long option, or name for positional
+ * arguments
+ *
+ * @param registry The SapRegistry to look in
+ * @param longopt Long option, including namespace
+ * @return Index of argument, -1 if none
+ */
+int sap_registry_find(const SapRegistry *registry, const char *longopt);
+
+/**
+ * @brief Frees memory of registry, including copied strings
+ *
+ * @param registry The SapRegistry to free
+ */
+void sap_registry_free(SapRegistry *registry);
+#endif
+
+/**
+ * @brief Gets size of memory needed by sap_cache_init()
+ *
+ * @param config The SapConfig to parse with
+ * @param capacity Maximum number of command lines remembered
+ * @param maxbytes Maximum length of command lines remembered, counting a NUL
+ * after every token but argv[0]
+ * @return Size in bytes
+ */
+size_t sap_cache_size(SapConfig config, unsigned int capacity,
+	unsigned int maxbytes);
+
+/**
+ * @brief Initialises empty cache in memory provided
+ *
+ * @param cache The SapCache to initialise
+ * @param config The SapConfig to parse with, to be kept alive while cache is
+ * in use
+ * @param memory Memory of at least sap_cache_size() bytes, to be kept alive
+ * while cache is in use
+ * @param size Size of memory
+ * @param capacity Maximum number of command lines remembered
+ * @param maxbytes Maximum length of command lines remembered
+ * @return 0 If initialised succesfully
+ * @return 1 If memory is too small or capacity is 0
+ */
+int sap_cache_init(SapCache *cache, SapConfig config, void *memory,
+	size_t size, unsigned int capacity, unsigned int maxbytes);
+
+/**
+ * @brief Parses arguments as sap_parse(), through the cache
+ *
+ * Only valid command lines are remembered, invalid ones are parsed in full
+ * every time, as are those longer than the cache allows and all of them if
+ * the configuration has callbacks or a stream.
+ *
+ * @param cache The SapCache to use
+ * @param argc Argument count
+ * @param argv Argument values
+ * @param result Where to store the tail and any error, may be NULL
+ * @return 0 If arguments parsed succesfully
+ * @return 1 If arguments were invalid
+ */
+int sap_cache_parse(SapCache *cache, int argc, char **argv,
+	SapResult *result);
+
+// helpers shared with the C++ interface, defined with the implementation
+/** @private */
+int _sap_check_arg_type(const char *arg, unsigned int flags);
+/** @private */
+unsigned int _sap_next_short(const char *s, unsigned int *shortopt);
+/** @private */
+int _sap_find_short(const SapConfig *config, unsigned int shortopt);
+/** @private */
+int _sap_find_long(const SapConfig *config, const char *longopt,
+	size_t limit, const char **value);
+/** @private */
+int _sap_find_name(const SapConfig *config, const char *name, size_t length,
+	int positional);
+/** @private */
+unsigned int _sap_next_positional(const SapConfig *config, unsigned int i);
+
+// position in tokens, from argv or a NUL-separated buffer
+/** @private */
+typedef struct SapCursor
+{
+	char **argv; // argument values, NULL if parsing buffer
+	int argc; // argument count
+	int j; // index of current token
+	const char *token; // current token, NULL past the last
+	const char *end; // end of buffer
+	const struct SapClassified *classified; // tokens of argv, NULL to classify
+} SapCursor;
+
+// walk over tokens looking up the argument each refers to, shared by the parse
+// and the C++ occurrence iterator
+/** @private */
+typedef struct SapWalk
+{
+	const SapConfig *config; // configuration walked with
+	SapCursor cursor; // token to carry on from, first of the tail once done
+	unsigned int k; // character of short options to carry on from, 0 if none
+	unsigned int positional; // positional argument to be filled next
+	int stop; // whether the end of options has been found
+} SapWalk;
+
+// argument found by the walk, or why it failed
+/** @private */
+typedef struct SapStep
+{
+	int arg; // argument, argcount for an extra positional, -1 if none
+	const char *token; // token of option or positional
+	int position; // index of token
+	const char *value; // value given, NULL for options without value
+	int valuetoken; // index of token value is in
+	SapErrorKind error; // why the walk failed, SAP_ERROR_NONE if it did not
+} SapStep;
+
+/** @private */
+void _sap_walk_start(SapWalk *walk, const SapConfig *config,
+	const SapCursor *cursor);
+/** @private */
+int _sap_walk_next(SapWalk *walk, SapStep *step);
+
+#ifdef SAP_FREESTANDING
+// string primitives standing in for the C library
+/** @private */
+size_t _sap_strlen(const char *s);
+/** @private */
+int _sap_strcmp(const char *a, const char *b);
+/** @private */
+int _sap_strncmp(const char *a, const char *b, size_t n);
+/** @private */
+int _sap_memcmp(const void *a, const void *b, size_t n);
+/** @private */
+void *_sap_memcpy(void *dest, const void *src, size_t n);
+/** @private */
+void *_sap_memmove(void *dest, const void *src, size_t n);
+/** @private */
+void *_sap_memset(void *dest, int c, size_t n);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+
+/**
+ * @brief C++ interface to sap
+ *
+ * Views over the results of sap_parse_args() that never allocate.
+ */
+namespace sap
+{
+
+#if __cplusplus >= 201703L
+	using string_view = std::string_view;
+#else
+	/**
+	 * @brief Non-owning view of a string, standing in for std::string_view
+	 * before C++17
+	 */
+	class string_view
+	{
+	public:
+		/**
+		 * @brief Constructs empty view
+		 */
+		constexpr string_view() : data_(nullptr), size_(0) {}
+
+		/**
+		 * @brief Constructs view of NUL-terminated string, empty if NULL
+		 *
+		 * @param str String to view
+		 */
+		string_view(const char *str)
+			: data_(str), size_(str ? SAP_STRLEN(str) : 0) {}
+
+		/**
+		 * @brief Constructs view of size characters at str
+		 *
+		 * @param str Start of string
+		 * @param size Number of characters
+		 */
+		constexpr string_view(const char *str, std::size_t size)
+			: data_(str), size_(size) {}
+
+		/** @brief Start of string */
+		constexpr const char *data() const { return data_; }
+		/** @brief Number of characters */
+		constexpr std::size_t size() const { return size_; }
+		/** @brief Whether view is empty */
+		constexpr bool empty() const { return size_ == 0; }
+		/** @brief Iterator to first character */
+		constexpr const char *begin() const { return data_; }
+		/** @brief Iterator past last character */
+		constexpr const char *end() const { return data_ + size_; }
+		/** @brief Character at index i */
+		constexpr char operator[](std::size_t i) const { return data_[i]; }
+
+		/** @brief Compares characters */
+		friend bool operator==(string_view a, string_view b)
+		{
+			return a.size_ == b.size_
+				&& (a.size_ == 0 || SAP_MEMCMP(a.data_, b.data_, a.size_) == 0);
+		}
+
+		/** @brief Compares characters */
+		friend bool operator!=(string_view a, string_view b)
+		{
+			return !(a == b);
+		}
+
+	private:
+		const char *data_;
+		std::size_t size_;
+	};
+#endif
+
+	/**
+	 * @brief Gets view of NUL-terminated string
+	 *
+	 * @param str String to view
+	 * @return View of str, empty if NULL
+	 */
+	inline string_view view(const char *str)
+	{
+		return str ? string_view(str) : string_view();
+	}
+
+	/**
+	 * @brief Non-owning view of a contiguous array, standing in for std::span
+	 * before C++20
+	 */
+	template <typename T>
+	class span
+	{
+	public:
+		/**
+		 * @brief Constructs view of size elements at data
+		 *
+		 * @param data Start of array
+		 * @param size Number of elements
+		 */
+		constexpr span(T *data, std::size_t size) : data_(data), size_(size) {}
+
+		/** @brief Start of array */
+		constexpr T *data() const { return data_; }
+		/** @brief Number of elements */
+		constexpr std::size_t size() const { return size_; }
+		/** @brief Whether view is empty */
+		constexpr bool empty() const { return size_ == 0; }
+		/** @brief Iterator to first element */
+		constexpr T *begin() const { return data_; }
+		/** @brief Iterator past last element */
+		constexpr T *end() const { return data_ + size_; }
+		/** @brief Element at index i */
+		constexpr T &operator[](std::size_t i) const { return data_[i]; }
+
+	private:
+		T *data_;
+		std::size_t size_;
+	};
+
+	/**
+	 * @brief Pair of iterators usable in range-based for loops
+	 */
+	template <typename It>
+	class range
+	{
+	public:
+		/**
+		 * @brief Constructs range from first to last
+		 *
+		 * @param first Iterator to first element
+		 * @param last Iterator past last element
+		 */
+		range(It first, It last) : first_(first), last_(last) {}
+
+		/** @brief Iterator to first element */
+		It begin() const { return first_; }
+		/** @brief Iterator past last element */
+		It end() const { return last_; }
+
+	private:
+		It first_, last_;
+	};
+
+	/**
+	 * @brief Key naming an argument, by short option or long option
+	 *
+	 * Constructed at compile time from a character or string literal, so
+	 * that lookups know the length of the name up front.
+	 */
+	class key
+	{
+	public:
+		/**
+		 * @brief Constructs key naming argument by short option
+		 *
+		 * @param shortopt Short option
+		 */
+		constexpr key(char32_t shortopt)
+			: name_(nullptr), size_(0), shortopt_(shortopt) {}
+
+		/**
+		 * @brief Constructs key naming argument by long option, or by name
+		 * for positional arguments
+		 *
+		 * @param name Long option
+		 */
+		template <std::size_t N>
+		constexpr key(const char (&name)[N])
+			: name_(name), size_(N - 1), shortopt_(0) {}
+
+		/**
+		 * @brief Finds argument key names, through the hash tables of the
+		 * configuration if compiled
+		 *
+		 * @param config Configuration to look in
+		 * @return Index of first argument named, -1 if none
+		 */
+		int find(const SapConfig &config) const
+		{
+			return name_ ? _sap_find_name(&config, name_, size_, 1)
+				: _sap_find_short(&config, shortopt_);
+		}
+
+	private:
+		const char *name_;
+		std::size_t size_;
+		char32_t shortopt_;
+	};
+
+	/**
+	 * @brief Single occurrence of an argument on the command line
+	 */
+	struct occurrence
+	{
+		/**
+		 * @brief Argument given, NULL for extra positional arguments
+		 */
+		const SapArgument *argument;
+
+		/**
+		 * @brief Value given, empty for options without value
+		 */
+		string_view value;
+
+		/**
+		 * @brief Index into argv of option or positional argument
+		 */
+		int position;
+	};
+
+	/**
+	 * @brief Iterator over occurrences of arguments in argv order
+	 *
+	 * Walks argv the same way sap_parse_args() does, without writing
+	 * anything. Options not in the configuration are skipped, as is the tail
+	 * left after the end of options, and the walk ends where the parse would
+	 * fail.
+	 */
+	class occurrence_iterator
+	{
+	public:
+		/** @brief Iterator category */
+		typedef std::forward_iterator_tag iterator_category;
+		/** @brief Value type */
+		typedef occurrence value_type;
+		/** @brief Difference type */
+		typedef std::ptrdiff_t difference_type;
+		/** @brief Pointer type */
+		typedef const occurrence *pointer;
+		/** @brief Reference type */
+		typedef const occurrence &reference;
+
+		/**
+		 * @brief Which occurrences to yield
+		 */
+		enum filter_type
+		{
+			all, /**< @brief Every occurrence */
+			argument, /**< @brief Occurrences of one argument */
+			positional /**< @brief Positional tokens */
+		};
+
+		/**
+		 * @brief Constructs iterator at first occurrence
+		 *
+		 * @param config Configuration parsed with
+		 * @param argc Argument count
+		 * @param argv Argument values
+		 * @param filter Which occurrences to yield
+		 * @param arg Argument to yield for filter argument
+		 */
+		occurrence_iterator(const SapConfig &config, int argc, char **argv,
+			filter_type filter = all, const SapArgument *arg = nullptr)
+			: walk_(), filter_(filter), arg_(arg), done_(false)
+		{
+			SapCursor cursor = SapCursor();
+			cursor.argv = argv;
+			cursor.argc = argc;
+			cursor.token = argc > 0 ? argv[0] : nullptr;
+			_sap_walk_start(&walk_, &config, &cursor);
+			advance();
+		}
+
+		/**
+		 * @brief Constructs end iterator
+		 */
+		occurrence_iterator()
+			: walk_(), filter_(all), arg_(nullptr), done_(true) {}
+
+		/** @brief Current occurrence */
+		reference operator*() const { return current_; }
+		/** @brief Current occurrence */
+		pointer operator->() const { return &current_; }
+
+		/** @brief Moves to next occurrence */
+		occurrence_iterator &operator++()
+		{
+			advance();
+			return *this;
+		}
+
+		/** @brief Moves to next occurrence */
+		occurrence_iterator operator++(int)
+		{
+			occurrence_iterator old = *this;
+			advance();
+			return old;
+		}
+
+		/** @brief Compares positions */
+		friend bool operator==(const occurrence_iterator &a,
+			const occurrence_iterator &b)
+		{
+			return a.done_ == b.done_
+				&& (a.done_ || (a.walk_.cursor.j == b.walk_.cursor.j
+					&& a.walk_.k == b.walk_.k));
+		}
+
+		/** @brief Compares positions */
+		friend bool operator!=(const occurrence_iterator &a,
+			const occurrence_iterator &b)
+		{
+			return !(a == b);
+		}
+
+	private:
+		// makes occurrence current if it passes the filter
+		bool yield(const SapArgument *arg, const char *value, int position)
+		{
+			if (filter_ == argument && arg != arg_) return false;
+			if (filter_ == positional
+				&& arg && arg->type != SAP_ARG_POSITIONAL) return false;
+			current_.argument = arg;
+			current_.value = view(value);
+			current_.position = position;
+			return true;
+		}
+
+		// moves to next occurrence that passes the filter
+		void advance()
+		{
+			SapStep step;
+			while (_sap_walk_next(&walk_, &step))
+			{
+				const SapConfig *config = walk_.config;
+				const SapArgument *arg = static_cast<unsigned int>(step.arg)
+					< config->argcount ? config->arguments + step.arg
+					: nullptr; // an extra positional
+				if (yield(arg, step.value, step.position)) return;
+			}
+			done_ = true;
+		}
+
+		SapWalk walk_; // where to carry on looking from
+		filter_type filter_;
+		const SapArgument *arg_;
+		bool done_;
+		occurrence current_;
+	};
+
+	/**
+	 * @brief View over the results of sap_parse_args()
+	 *
+	 * Holds no more than the configuration and argv it was constructed with,
+	 * which must outlive it. No access allocates.
+	 */
+	class results
+	{
+	public:
+		/**
+		 * @brief Constructs view over results of parsing argv with config
+		 *
+		 * @param config Configuration parsed with
+		 * @param argc Argument count
+		 * @param argv Argument values
+		 */
+		results(const SapConfig &config, int argc, char **argv)
+			: config_(&config), argc_(argc), argv_(argv) {}
+
+		/**
+		 * @brief Gets all arguments of the configuration
+		 *
+		 * @return Arguments
+		 */
+		span<const SapArgument> arguments() const
+		{
+			return span<const SapArgument>(config_->arguments,
+				config_->argcount);
+		}
+
+		/**
+		 * @brief Gets the whole command line
+		 *
+		 * @return Argument values
+		 */
+		span<char *const> argv() const
+		{
+			return span<char *const>(argv_, argc_);
+		}
+
+		/**
+		 * @brief Finds argument named by key, through hash tables if the
+		 * configuration is compiled rather than by scanning the arguments
+		 *
+		 * @param k Key naming argument
+		 * @return Argument, NULL if none
+		 */
+		const SapArgument *find(key k) const
+		{
+			int i = k.find(*config_);
+			return i < 0 ? nullptr : config_->arguments + i;
+		}
+
+		/**
+		 * @brief Gets whether argument named by key is set
+		 *
+		 * @param k Key naming argument
+		 * @return Whether argument is set
+		 */
+		bool is_set(key k) const
+		{
+			const SapArgument *arg = find(k);
+			return arg && arg->set;
+		}
+
+		/**
+		 * @brief Gets number of times argument named by key is given
+		 *
+		 * @param k Key naming argument
+		 * @return Number of times argument is given, 0 if none
+		 */
+		unsigned int count(key k) const
+		{
+			const SapArgument *arg = find(k);
+			return arg ? arg->count : 0;
+		}
+
+		/**
+		 * @brief Gets value of argument named by key, falling back to its
+		 * default value
+		 *
+		 * @param k Key naming argument
+		 * @return Value, empty if none
+		 */
+		string_view value(key k) const
+		{
+			const SapArgument *arg = find(k);
+			return view(arg ? sap_get_value(arg) : nullptr);
+		}
+
+		/**
+		 * @brief Gets index into choices of value of argument named by key,
+		 * falling back to its default value
+		 *
+		 * @param k Key naming argument
+		 * @return Index into choices, -1 if none
+		 */
+		int choice(key k) const
+		{
+			const SapArgument *arg = find(k);
+			return arg ? sap_get_choice(arg) : -1;
+		}
+
+		/**
+		 * @brief Gets every occurrence of an argument in argv order
+		 *
+		 * @return Occurrences
+		 */
+		range<occurrence_iterator> occurrences() const
+		{
+			return range<occurrence_iterator>(
+				occurrence_iterator(*config_, argc_, argv_),
+				occurrence_iterator());
+		}
+
+		/**
+		 * @brief Gets every occurrence of the argument named by key in argv
+		 * order, including repeats of the same option
+		 *
+		 * @param k Key naming argument
+		 * @return Occurrences
+		 */
+		range<occurrence_iterator> occurrences(key k) const
+		{
+			const SapArgument *arg = find(k);
+			if (!arg) // nothing to find
+				return range<occurrence_iterator>(occurrence_iterator(),
+					occurrence_iterator());
+			return range<occurrence_iterator>(
+				occurrence_iterator(*config_, argc_, argv_,
+					occurrence_iterator::argument, arg),
+				occurrence_iterator());
+		}
+
+		/**
+		 * @brief Gets every positional token in argv order, including those
+		 * beyond the positional arguments configured, which have a NULL
+		 * argument
+		 *
+		 * @return Occurrences
+		 */
+		range<occurrence_iterator> positionals() const
+		{
+			return range<occurrence_iterator>(
+				occurrence_iterator(*config_, argc_, argv_,
+					occurrence_iterator::positional),
+				occurrence_iterator());
+		}
+
+	private:
+		const SapConfig *config_;
+		int argc_;
+		char **argv_;
+	};
+
+#ifndef SAP_FREESTANDING
+	/**
+	 * @brief Owner of a configuration and the results parsed into it
+	 *
+	 * All argument records, rules, choices and strings are copied into one
+	 * allocation together with the compiled configuration, so that building,
+	 * moving and destroying a configuration costs one allocation and one
+	 * free. Movable but not copyable. Not available if SAP_FREESTANDING is
+	 * defined, as it allocates.
+	 */
+	class config
+	{
+	public:
+		/**
+		 * @brief Constructs empty configuration
+		 */
+		config() noexcept : arena_(nullptr), config_() {}
+
+		/**
+		 * @brief Constructs owned copy of configuration built elsewhere
+		 *
+		 * The compiled configuration is not copied but compiled anew, and is
+		 * left NULL if rules refer to nonexistent arguments.
+		 *
+		 * @param source Configuration to copy
+		 */
+		explicit config(const SapConfig &source) : arena_(nullptr), config_()
+		{
+			copy(source);
+		}
+
+		/**
+		 * @brief Constructs configuration from lists of arguments and rules
+		 *
+		 * @param name Name of the application
+		 * @param version_major Major version
+		 * @param version_minor Minor version
+		 * @param version_patch Patch version
+		 * @param author Author's name
+		 * @param about Short description of program
+		 * @param arguments Argument configurations
+		 * @param rules Constraints between arguments
+		 */
+		config(const char *name, unsigned int version_major,
+			unsigned int version_minor, unsigned int version_patch,
+			const char *author, const char *about,
+			std::initializer_list<SapArgument> arguments,
+			std::initializer_list<SapRule> rules = {})
+			: arena_(nullptr), config_()
+		{
+			SapConfig source = SapConfig();
+			source.name = name;
+			source.version_major = version_major;
+			source.version_minor = version_minor;
+			source.version_patch = version_patch;
+			source.author = author;
+			source.about = about;
+			source.arguments = const_cast<SapArgument *>(arguments.begin());
+			source.argcount = static_cast<unsigned int>(arguments.size());
+			source.rules = const_cast<SapRule *>(rules.begin());
+			source.rulecount = static_cast<unsigned int>(rules.size());
+			copy(source);
+		}
+
+		/** @brief Takes over configuration of other, leaving it empty */
+		config(config &&other) noexcept
+			: arena_(other.arena_), config_(other.config_)
+		{
+			other.arena_ = nullptr;
+			other.config_ = SapConfig();
+		}
+
+		/** @brief Takes over configuration of other, leaving it empty */
+		config &operator=(config &&other) noexcept
+		{
+			if (this != &other)
+			{
+				::operator delete(arena_);
+				arena_ = other.arena_;
+				config_ = other.config_;
+				other.arena_ = nullptr;
+				other.config_ = SapConfig();
+			}
+			return *this;
+		}
+
+		config(const config &) = delete;
+		config &operator=(const config &) = delete;
+
+		/** @brief Frees configuration */
+		~config() { ::operator delete(arena_); }
+
+		/**
+		 * @brief Gets configuration, to pass to sap functions
+		 *
+		 * @return Configuration
+		 */
+		const SapConfig &get() const { return config_; }
+
+		/**
+		 * @brief Gets argument i
+		 *
+		 * @param i Index of argument
+		 * @return Argument
+		 */
+		SapArgument &operator[](std::size_t i) { return config_.arguments[i]; }
+
+		/**
+		 * @brief Gets argument i
+		 *
+		 * @param i Index of argument
+		 * @return Argument
+		 */
+		const SapArgument &operator[](std::size_t i) const
+		{
+			return config_.arguments[i];
+		}
+
+		/**
+		 * @brief Parses arguments into this configuration, as sap_parse()
+		 *
+		 * @param argc Argument count
+		 * @param argv Argument values
+		 * @param result Where to store the tail and any error, may be NULL
+		 * @return 0 If arguments parsed succesfully
+		 * @return 1 If arguments were invalid
+		 */
+		int parse(int argc, char **argv, SapResult *result = nullptr)
+		{
+			return sap_parse(config_, argc, argv, result);
+		}
+
+		/**
+		 * @brief Gets view over results of parsing argv
+		 *
+		 * @param argc Argument count
+		 * @param argv Argument values
+		 * @return View over results
+		 */
+		sap::results results(int argc, char **argv) const
+		{
+			return sap::results(config_, argc, argv);
+		}
+
+	private:
+		// size of string including NUL, 0 for NULL
+		static std::size_t string_size(const char *str)
+		{
+			return str ? std::strlen(str) + 1 : 0;
+		}
+
+		// copies string to p, moving p past it
+		static const char *copy_string(char *&p, const char *str)
+		{
+			if (!str) return nullptr;
+			std::size_t size = string_size(str);
+			char *copy = static_cast<char *>(std::memcpy(p, str, size));
+			p += size;
+			return copy;
+		}
+
+		// copies source into a single new arena, largest alignment first,
+		// the compiled configuration padded so that arguments stay aligned
+		void copy(const SapConfig &source)
+		{
+			std::size_t words = sizeof(SapWord) * SAP_WORDS(source.argcount);
+			std::size_t compiled = (sap_compile_size(source)
+				+ sizeof(SapWord) - 1) / sizeof(SapWord) * sizeof(SapWord);
+			std::size_t size = words + compiled
+				+ sizeof(SapArgument) * source.argcount
+				+ sizeof(SapRule) * source.rulecount
+				+ sizeof(const char *) * source.sectioncount
+				+ string_size(source.name) + string_size(source.author)
+				+ string_size(source.about);
+			for (unsigned int s = 0; s < source.sectioncount; s++)
+				size += string_size(source.sections[s]);
+			for (unsigned int r = 0; r < source.rulecount; r++)
+				size += sizeof(unsigned int) * source.rules[r].groupcount;
+			for (unsigned int i = 0; i < source.argcount; i++)
+			{
+				const SapArgument &arg = source.arguments[i];
+				size += string_size(arg.longopt) + string_size(arg.help)
+					+ string_size(arg.default_value)
+					+ sizeof(const char *) * arg.choicecount;
+				for (unsigned int c = 0; c < arg.choicecount; c++)
+					size += string_size(arg.choices[c]);
+			}
+
+			arena_ = ::operator new(size);
+			char *p = static_cast<char *>(arena_) + words + compiled;
+
+			config_ = source;
+			config_.compiled = nullptr;
+			config_.setbits = static_cast<SapWord *>(
+				std::memset(arena_, 0, words));
+			config_.arguments = reinterpret_cast<SapArgument *>(p);
+			p += sizeof(SapArgument) * source.argcount;
+			config_.rules = reinterpret_cast<SapRule *>(p);
+			p += sizeof(SapRule) * source.rulecount;
+			const char **sections = reinterpret_cast<const char **>(p);
+			p += sizeof(const char *) * source.sectioncount;
+			if (source.sectioncount) config_.sections = sections;
+			for (unsigned int i = 0; i < source.argcount; i++)
+			{
+				SapArgument &arg = config_.arguments[i] = source.arguments[i];
+				if (arg.set) // cleared by the next parse
+					config_.setbits[i / SAP_WORD_BITS] |=
+						(SapWord) 1 << (i % SAP_WORD_BITS);
+				const char **choices = reinterpret_cast<const char **>(p);
+				p += sizeof(const char *) * arg.choicecount;
+				if (arg.choicecount) arg.choices = choices;
+			}
+			for (unsigned int r = 0; r < source.rulecount; r++)
+			{
+				SapRule &rule = config_.rules[r] = source.rules[r];
+				std::size_t groupsize = sizeof(unsigned int) * rule.groupcount;
+				if (groupsize)
+					rule.group = static_cast<unsigned int *>(
+						std::memcpy(p, rule.group, groupsize));
+				p += groupsize;
+			}
+			for (unsigned int i = 0; i < source.argcount; i++)
+			{
+				SapArgument &arg = config_.arguments[i];
+				arg.longopt = copy_string(p, arg.longopt);
+				arg.help = copy_string(p, arg.help);
+				arg.default_value = copy_string(p, arg.default_value);
+				for (unsigned int c = 0; c < arg.choicecount; c++)
+					const_cast<const char **>(arg.choices)[c] = copy_string(p,
+						source.arguments[i].choices[c]);
+			}
+			config_.name = copy_string(p, source.name);
+			config_.author = copy_string(p, source.author);
+			config_.about = copy_string(p, source.about);
+			for (unsigned int s = 0; s < source.sectioncount; s++)
+				sections[s] = copy_string(p, source.sections[s]);
+
+			sap_compile(&config_, static_cast<char *>(arena_) + words,
+				compiled);
+		}
+
+		void *arena_;
+		SapConfig config_;
+	};
+#endif
+}
+
+#endif
+
+#endif
+
+// implementation, compiled where SAP_IMPLEMENTATION is defined
+#if defined(SAP_IMPLEMENTATION) && !defined(__SAP_IMPLEMENTATION_INCLUDED__)
+#define __SAP_IMPLEMENTATION_INCLUDED__
+
+// errno of numbers out of range
+#ifndef SAP_FREESTANDING
+	#include <errno.h>
+#endif
+
+// system headers for sweeping /proc and watching files, and for parsing on
+// threads if asked for
+#if defined(__linux__) && !defined(SAP_FREESTANDING)
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <sys/inotify.h>
+	#include <unistd.h>
+	#ifdef SAP_THREADS
+		#include <pthread.h>
+	#endif
+#endif
+
+// vector instructions for scanning tokens, AVX2 only if found at runtime
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) \
+	&& !defined(SAP_FREESTANDING)
+	#define SAP_SIMD
+	#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// classes of bytes, independent of locale
+/** @private */
+#ifdef __cplusplus
+constexpr
+#else
+static const
+#endif
+unsigned char _sap_char_class[256] =
+{
+#define SAP_A SAP_CHAR_ALPHA
+#define SAP_D SAP_CHAR_DIGIT
+#define SAP_C SAP_CHAR_CONT
+#define SAP_L SAP_CHAR_LEAD
+	0, 0, 0, 0, 0, 0, 0, 0, // 00
+	0, 0, 0, 0, 0, 0, 0, 0, // 08
+	0, 0, 0, 0, 0, 0, 0, 0, // 10
+	0, 0, 0, 0, 0, 0, 0, 0, // 18
+	0, 0, 0, 0, 0, 0, 0, 0, // 20
+	0, 0, 0, 0, 0, 0, 0, 0, // 28
+	SAP_D, SAP_D, SAP_D, SAP_D, SAP_D, SAP_D, SAP_D, SAP_D, // 30
+	SAP_D, SAP_D, 0, 0, 0, 0, 0, 0, // 38
+	0, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, // 40
+	SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, // 48
+	SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, // 50
+	SAP_A, SAP_A, SAP_A, 0, 0, 0, 0, 0, // 58
+	0, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, // 60
+	SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, // 68
+	SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, SAP_A, // 70
+	SAP_A, SAP_A, SAP_A, 0, 0, 0, 0, 0, // 78
+	SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, // 80
+	SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, // 88
+	SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, // 90
+	SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, // 98
+	SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, // A0
+	SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, // A8
+	SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, // B0
+	SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, SAP_C, // B8
+	0, 0, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, // C0
+	SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, // C8
+	SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, // D0
+	SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, // D8
+	SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, // E0
+	SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, // E8
+	SAP_L, SAP_L, SAP_L, SAP_L, SAP_L, 0, 0, 0, // F0
+	0, 0, 0, 0, 0, 0, 0, 0, // F8
+#undef SAP_A
+#undef SAP_D
+#undef SAP_C
+#undef SAP_L
+};
+
+#ifdef SAP_FREESTANDING
+size_t _sap_strlen(const char *s)
+{
+	const char *c = s;
+	while (*c) c++;
+	return c - s;
+}
+
+int _sap_strcmp(const char *a, const char *b)
+{
+	for (; *a && *a == *b; a++, b++);
+	return (unsigned char) *a - (unsigned char) *b;
+}
+
+int _sap_strncmp(const char *a, const char *b, size_t n)
+{
+	for (; n && *a && *a == *b; n--, a++, b++);
+	return n ? (unsigned char) *a - (unsigned char) *b : 0;
+}
+
+int _sap_memcmp(const void *a, const void *b, size_t n)
+{
+	const unsigned char *x = (const unsigned char *) a;
+	const unsigned char *y = (const unsigned char *) b;
+	for (; n; n--, x++, y++)
+		if (*x != *y) return *x - *y;
+	return 0;
+}
+
+void *_sap_memcpy(void *dest, const void *src, size_t n)
+{
+	unsigned char *d = (unsigned char *) dest;
+	const unsigned char *s = (const unsigned char *) src;
+	while (n--) *d++ = *s++;
+	return dest;
+}
+
+void *_sap_memmove(void *dest, const void *src, size_t n)
+{
+	unsigned char *d = (unsigned char *) dest;
+	const unsigned char *s = (const unsigned char *) src;
+	if (d < s) while (n--) *d++ = *s++;
+	else while (n--) d[n] = s[n];
+	return dest;
+}
+
+void *_sap_memset(void *dest, int c, size_t n)
+{
+	unsigned char *d = (unsigned char *) dest;
+	while (n--) *d++ = (unsigned char) c;
+	return dest;
+}
+#endif
+
+// gets class of byte
+/** @private */
+unsigned char _sap_class(char c)
+{
+	return _sap_char_class[(unsigned char) c];
+}
+
+// reads short option at s into shortopt, returning its length in bytes, 0 if
+// there is none
+/** @private */
+unsigned int _sap_next_short(const char *s, unsigned int *shortopt)
+{
+	unsigned char c = (unsigned char) s[0];
+	if (_sap_class(s[0]) & SAP_CHAR_ALPHA)
+	{
+		*shortopt = c;
+		return 1;
+	}
+	if (!(_sap_class(s[0]) & SAP_CHAR_LEAD)) return 0;
+
+	// multibyte UTF-8 character
+	unsigned int length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+	*shortopt = c & (0x7F >> length);
+	for (unsigned int k = 1; k < length; k++)
+	{
+		if (!(_sap_class(s[k]) & SAP_CHAR_CONT)) return 0;
+		*shortopt = (*shortopt << 6) | ((unsigned char) s[k] & 0x3F);
+	}
+	return length;
+}
+
+// checks whether s, without its leading -, looks like a number
+/** @private */
+int _sap_is_number(const char *s)
+{
+	unsigned int digits = 0, dot = 0;
+	for (; *s; s++)
+	{
+		if (_sap_class(*s) & SAP_CHAR_DIGIT) digits++;
+		else if (*s == '.' && !dot) dot = 1;
+		else if ((*s == 'e' || *s == 'E') && digits)
+		{
+			// exponent, the rest must be an integer
+			if (*++s == '+' || *s == '-') s++;
+			if (!(_sap_class(*s) & SAP_CHAR_DIGIT)) return 0;
+			while (_sap_class(*s) & SAP_CHAR_DIGIT) s++;
+			return *s == '\0';
+		}
+		else return 0;
+	}
+	return digits > 0;
+}
+
+// checks argument type
+/** @private */
+int _sap_check_arg_type(const char *arg, unsigned int flags)
+{
+	// normal string
+	if (arg[0] != '-' || arg[1] == '\0') return ARG_NORMAL;
+
+	// long option, or end of options if nothing follows
+	if (arg[1] == '-') return arg[2] == '\0' ? ARG_END : ARG_LONGOPT;
+
+	// short options
+	if (_sap_class(arg[1]) & (SAP_CHAR_ALPHA | SAP_CHAR_LEAD))
+		return ARG_SHORTOPT;
+
+	// negative number
+	if ((flags & SAP_FLAG_NUMBERS) && _sap_is_number(arg + 1))
+		return ARG_NORMAL;
+
+	// unknown
+	return ARG_ERROR;
+}
+
+// writes shortopt as NUL-terminated UTF-8 into out, of at least 5 bytes
+/** @private */
+void _sap_encode_short(unsigned int shortopt, char *out)
+{
+	if (shortopt < 0x80) *out++ = (char) shortopt;
+	else
+	{
+		unsigned int length = shortopt < 0x800 ? 2 : shortopt < 0x10000 ? 3 : 4;
+		*out++ = (char) ((0xF00 >> length) | (shortopt >> (6 * (length - 1))));
+		for (unsigned int k = length - 1; k > 0; k--)
+			*out++ = (char) (0x80 | ((shortopt >> (6 * (k - 1))) & 0x3F));
+	}
+	*out = '\0';
+}
+
+// length of a token and offset of its first '=', found in one pass
+/** @private */
+typedef struct SapScan
+{
+	size_t length; // bytes before the NUL
+	size_t equals; // bytes before the first '=', length if none
+} SapScan;
+
+// scans token a byte at a time
+/** @private */
+SapScan _sap_scan_bytes(const char *s)
+{
+	SapScan scan;
+	const char *c = s;
+	while (*c && *c != '=') c++;
+	scan.equals = c - s;
+	while (*c) c++;
+	scan.length = c - s;
+	return scan;
+}
+
+#ifdef SAP_SIMD
+// blocks are read whole from aligned addresses, which never cross a page
+// boundary, so that reading the block holding the NUL cannot fault even
+// where the token ends before the block does, as with strlen() of C
+// libraries; the bytes past the NUL are masked off, but would still be
+// flagged by AddressSanitizer, so only tokens of unknown length are scanned
+// this way
+#define SAP_WHOLE_BLOCKS __attribute__((no_sanitize_address))
+
+// folds masks of NUL and '=' bytes of a block, offset bytes into the token,
+// into scan, 1 once the NUL is found
+/** @private */
+int _sap_scan_block(SapScan *scan, size_t offset, unsigned int nul,
+	unsigned int equals)
+{
+	if (nul) equals &= nul ^ (nul - 1); // none after the NUL
+	if (equals && scan->equals == (size_t) -1)
+		scan->equals = offset + __builtin_ctz(equals);
+	if (!nul) return 0;
+	scan->length = offset + __builtin_ctz(nul);
+	if (scan->equals == (size_t) -1) scan->equals = scan->length;
+	return 1;
+}
+
+// scans token 16 bytes at a time
+/** @private */
+SAP_WHOLE_BLOCKS
+SapScan _sap_scan_sse2(const char *s)
+{
+	SapScan scan = { 0, (size_t) -1 };
+	unsigned int shift = (unsigned int) ((size_t) s & 15);
+	const __m128i *block = (const __m128i *) (s - shift);
+	const __m128i nul = _mm_setzero_si128(), equals = _mm_set1_epi8('=');
+	for (size_t offset = 0; ; block++, offset += 16 - shift, shift = 0)
+	{
+		__m128i bytes = _mm_load_si128(block);
+		if (_sap_scan_block(&scan, offset,
+			(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, nul))
+				>> shift,
+			(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, equals))
+				>> shift))
+			return scan;
+	}
+}
+
+// scans token 32 bytes at a time
+/** @private */
+SAP_WHOLE_BLOCKS __attribute__((target("avx2")))
+SapScan _sap_scan_avx2(const char *s)
+{
+	SapScan scan = { 0, (size_t) -1 };
+	unsigned int shift = (unsigned int) ((size_t) s & 31);
+	const __m256i *block = (const __m256i *) (s - shift);
+	const __m256i nul = _mm256_setzero_si256(),
+		equals = _mm256_set1_epi8('=');
+	for (size_t offset = 0; ; block++, offset += 32 - shift, shift = 0)
+	{
+		__m256i bytes = _mm256_load_si256(block);
+		if (_sap_scan_block(&scan, offset,
+			(unsigned int) _mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(bytes, nul)) >> shift,
+			(unsigned int) _mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(bytes, equals)) >> shift))
+			return scan;
+	}
+}
+
+// scans token known to end within limit bytes 16 bytes at a time, never
+// reading past them, then the bytes left over one at a time
+/** @private */
+SapScan _sap_scan_bounded(const char *s, size_t limit)
+{
+	SapScan scan = { 0, (size_t) -1 };
+	const __m128i nul = _mm_setzero_si128(), equals = _mm_set1_epi8('=');
+	size_t offset;
+	for (offset = 0; offset + 16 <= limit; offset += 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i *) (s + offset));
+		if (_sap_scan_block(&scan, offset,
+			(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, nul)),
+			(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, equals))))
+			return scan;
+	}
+	SapScan tail = _sap_scan_bytes(s + offset);
+	if (scan.equals == (size_t) -1) scan.equals = offset + tail.equals;
+	scan.length = offset + tail.length;
+	return scan;
+}
+
+/** @private */
+SapScan _sap_scan_resolve(const char *s);
+
+// scanner of tokens of unknown length, resolved on first use to the widest
+// instructions the processor has
+/** @private */
+static SapScan (*_sap_scan_widest)(const char *s) = _sap_scan_resolve;
+
+/** @private */
+SapScan _sap_scan_resolve(const char *s)
+{
+	SapScan (*scan)(const char *s) = __builtin_cpu_supports("avx2")
+		? _sap_scan_avx2 : _sap_scan_sse2;
+	__atomic_store_n(&_sap_scan_widest, scan, __ATOMIC_RELAXED);
+	return scan(s);
+}
+#endif
+
+// scans token, limit being the number of bytes from it known to be readable,
+// which it ends within, or (size_t) -1 if not known
+/** @private */
+SapScan _sap_scan(const char *s, size_t limit)
+{
+#ifdef SAP_SIMD
+	if (limit != (size_t) -1) return _sap_scan_bounded(s, limit);
+	return __atomic_load_n(&_sap_scan_widest, __ATOMIC_RELAXED)(s);
+#else
+	(void) limit;
+	return _sap_scan_bytes(s);
+#endif
+}
+
+// hashes string, FNV-1a
+/** @private */
+unsigned int _sap_hash(const char *s)
+{
+	unsigned int hash = 2166136261u;
+	for (; *s; s++) hash = (hash ^ (unsigned char) *s) * 16777619u;
+	return hash;
+}
+
+// hashes first n bytes of string, as _sap_hash() would were they all of it
+/** @private */
+unsigned int _sap_hash_n(const char *s, size_t n)
+{
+	unsigned int hash = 2166136261u;
+	for (size_t k = 0; k < n; k++)
+		hash = (hash ^ (unsigned char) s[k]) * 16777619u;
+	return hash;
+}
+
+// gets size of long option hash table, a power of 2 at most half full
+/** @private */
+unsigned int _sap_table_size(unsigned int argcount)
+{
+	unsigned int size = 2;
+	while (size < 2 * argcount) size *= 2;
+	return size;
+}
+
+// gets hash of a short option outside ASCII
+/** @private */
+unsigned int _sap_hash_short(unsigned int shortopt)
+{
+	unsigned int x = shortopt * 2654435761u;
+	return x ^ (x >> 16);
+}
+
+// gets short option of argument as a code point, 0 if none
+/** @private */
+unsigned int _sap_shortopt(const SapArgument *arg)
+{
+	return arg->wideopt ? arg->wideopt : (unsigned char) arg->shortopt;
+}
+
+// finds option with given short option, -1 if none
+/** @private */
+int _sap_find_short(const SapConfig *config, unsigned int shortopt)
+{
+	const SapCompiled *compiled = config->compiled;
+	if (compiled)
+	{
+		if (shortopt < SAP_SHORT_TABLE)
+			return (int) compiled->shorttable[shortopt] - 1;
+
+		// linear probing, at least half the table is empty
+		for (unsigned int h = _sap_hash_short(shortopt); ; h++)
+		{
+			unsigned int i = compiled->widetable[h & compiled->tablemask];
+			if (i == 0 || compiled->shortopts[i - 1] == shortopt)
+				return (int) i - 1;
+		}
+	}
+
+	for (unsigned int i = 0; i < config->argcount; i++)
+	{
+		SapArgument *arg = config->arguments + i;
+		if (arg->type != SAP_ARG_POSITIONAL && _sap_shortopt(arg) == shortopt)
+			return i;
+	}
+	return -1;
+}
+
+// finds option with given long option, ending within limit bytes or (size_t)
+// -1 if not known, -1 if none
+/** @private */
+int _sap_find_long(const SapConfig *config, const char *longopt,
+	size_t limit, const char **value)
+{
+	// the name ends at the first '=', the value attached to it follows
+	SapScan scan = _sap_scan(longopt, limit);
+	size_t length = scan.equals;
+	*value = length < scan.length ? longopt + length + 1 : NULL;
+	return _sap_find_name(config, longopt, length, 0);
+}
+
+// finds argument named by the first length bytes of name, an option by its
+// long option or, if positional is set, a positional argument by its name
+// too, -1 if none
+/** @private */
+int _sap_find_name(const SapConfig *config, const char *name, size_t length,
+	int positional)
+{
+	const SapCompiled *compiled = config->compiled;
+	if (compiled)
+	{
+		// linear probing, records only read on a full hash match, names
+		// compared as blocks of known length
+		unsigned int hash = _sap_hash_n(name, length);
+		for (unsigned int h = hash; ; h++)
+		{
+			unsigned int i = compiled->longtable[h & compiled->tablemask];
+			if (i == 0) return -1;
+			if (compiled->hashes[i - 1] == hash
+				&& compiled->lengths[i - 1] == length
+				&& (positional
+					|| compiled->types[i - 1] != SAP_ARG_POSITIONAL)
+				&& SAP_MEMCMP(config->arguments[i - 1].longopt, name,
+					length) == 0)
+				return i - 1;
+		}
+	}
+
+	for (unsigned int i = 0; i < config->argcount; i++)
+	{
+		SapArgument *arg = config->arguments + i;
+		if (arg->longopt && (arg->type != SAP_ARG_POSITIONAL || positional)
+			&& SAP_STRNCMP(arg->longopt, name, length) == 0
+			&& arg->longopt[length] == '\0')
+			return i;
+	}
+	return -1;
+}
+
+// finds first positional argument from index i, argcount if none
+/** @private */
+unsigned int _sap_next_positional(const SapConfig *config, unsigned int i)
+{
+	if (config->compiled)
+		while (i < config->argcount
+			&& config->compiled->types[i] != SAP_ARG_POSITIONAL) i++;
+	else
+		while (i < config->argcount
+			&& config->arguments[i].type != SAP_ARG_POSITIONAL) i++;
+	return i;
+}
+
+// gets number of entries in choice table of argument, 0 if it needs none
+/** @private */
+unsigned int _sap_choice_table_size(const SapArgument *arg)
+{
+	if (arg->type != SAP_ARG_OPTION_VALUE || !arg->choicecount) return 0;
+	unsigned int slots = _sap_table_size(arg->choicecount);
+	return 1 + slots / 2 + slots;
+}
+
+// gets slot of choice with given hash under displacement d
+/** @private */
+unsigned int _sap_choice_slot(unsigned int hash, unsigned int d,
+	unsigned int mask)
+{
+	unsigned int x = (hash ^ d) * 2654435761u;
+	return (x ^ (x >> 16)) & mask;
+}
+
+// places choices in bucket b of table at displacement d, 1 without placing
+// any if one lands in a taken slot
+/** @private */
+int _sap_place_choices(const SapArgument *arg, unsigned int *table,
+	unsigned int b, unsigned int d)
+{
+	unsigned int buckets = (table[0] + 1) / 2;
+	unsigned int *slots = table + 1 + buckets;
+	for (unsigned int c = 0; c < arg->choicecount; c++)
+	{
+		unsigned int hash = _sap_hash(arg->choices[c]);
+		if ((hash & (buckets - 1)) != b) continue;
+		unsigned int *slot = slots + _sap_choice_slot(hash, d, table[0]);
+		if (*slot)
+		{
+			// take back those placed so far
+			for (unsigned int u = 0; u < c; u++)
+			{
+				hash = _sap_hash(arg->choices[u]);
+				if ((hash & (buckets - 1)) != b) continue;
+				slot = slots + _sap_choice_slot(hash, d, table[0]);
+				if (*slot == u + 1) *slot = 0;
+			}
+			return 1;
+		}
+		*slot = c + 1;
+	}
+	return 0;
+}
+
+// builds perfect hash of choices of argument into table, hashing choices into
+// buckets then finding a displacement per bucket that puts its choices in
+// empty slots, 1 if none is found
+/** @private */
+int _sap_build_choices(const SapArgument *arg, unsigned int *table)
+{
+	unsigned int slots = _sap_table_size(arg->choicecount);
+	unsigned int buckets = slots / 2;
+	unsigned int *displacements = table + 1;
+	table[0] = slots - 1;
+	SAP_MEMSET(displacements, 0, sizeof(unsigned int) * (buckets + slots));
+
+	// count choices per bucket, marked as not placed yet
+	unsigned int largest = 0;
+	for (unsigned int c = 0; c < arg->choicecount; c++)
+	{
+		unsigned int *d = displacements
+			+ (_sap_hash(arg->choices[c]) & (buckets - 1));
+		*d = (*d + 1) | SAP_CHOICE_PENDING;
+		if ((*d & ~SAP_CHOICE_PENDING) > largest)
+			largest = *d & ~SAP_CHOICE_PENDING;
+	}
+
+	// place fullest buckets first, while most slots are empty
+	for (unsigned int size = largest; size > 0; size--)
+		for (unsigned int b = 0; b < buckets; b++)
+		{
+			if (displacements[b] != (size | SAP_CHOICE_PENDING)) continue;
+			unsigned int d = 0;
+			while (_sap_place_choices(arg, table, b, d))
+				if (++d == SAP_CHOICE_TRIES * slots) return 1;
+			displacements[b] = d;
+		}
+	return 0;
+}
+
+// finds index of value among choices of argument i, -1 if none
+/** @private */
+int _sap_find_choice(const SapConfig *config, unsigned int i,
+	const char *value)
+{
+	const SapArgument *arg = config->arguments + i;
+	const SapCompiled *compiled = config->compiled;
+	if (compiled && compiled->choiceoffsets[i])
+	{
+		// one probe, records only read on a hit
+		const unsigned int *table = compiled->choicetables
+			+ compiled->choiceoffsets[i] - 1;
+		unsigned int buckets = (table[0] + 1) / 2;
+		unsigned int hash = _sap_hash(value);
+		unsigned int d = table[1 + (hash & (buckets - 1))];
+		unsigned int c = table[1 + buckets
+			+ _sap_choice_slot(hash, d, table[0])];
+		return c && SAP_STRCMP(arg->choices[c - 1], value) == 0 ? (int) c - 1
+			: -1;
+	}
+
+	for (unsigned int c = 0; c < arg->choicecount; c++)
+		if (SAP_STRCMP(arg->choices[c], value) == 0) return c;
+	return -1;
+}
+
+// sets value of valued option i, 1 if it is not one of its choices
+/** @private */
+int _sap_set_value(const SapConfig *config, unsigned int i,
+	const char *value)
+{
+	SapArgument *arg = config->arguments + i;
+	arg->value = value;
+	if (!arg->choicecount) return 0;
+	arg->choice = _sap_find_choice(config, i, value);
+	return arg->choice < 0;
+}
+
+// counts bits set in word
+/** @private */
+unsigned int _sap_popcount(SapWord word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(word);
+#else
+	unsigned int count = 0;
+	for (; word; count++) word &= word - 1;
+	return count;
+#endif
+}
+
+// counts trailing zero bits of nonzero word
+/** @private */
+unsigned int _sap_ctz(SapWord word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(word);
+#else
+	unsigned int count = 0;
+	for (; !(word & 1); word >>= 1) count++;
+	return count;
+#endif
+}
+
+// sets bit i of bitset to value
+/** @private */
+void _sap_bit_set(SapWord *bits, unsigned int i, int value)
+{
+	SapWord bit = (SapWord) 1 << (i % SAP_WORD_BITS);
+	if (value) bits[i / SAP_WORD_BITS] |= bit;
+	else bits[i / SAP_WORD_BITS] &= ~bit;
+}
+
+// gets bit i of bitset
+/** @private */
+int _sap_bit_get(const SapWord *bits, unsigned int i)
+{
+	return (bits[i / SAP_WORD_BITS] >> (i % SAP_WORD_BITS)) & 1;
+}
+
+// records argument i, argcount if none, as matched at position in the stream
+// and fires its callbacks, 1 if one aborts
+/** @private */
+int _sap_match(const SapConfig *config, unsigned int i, const char *value,
+	int position)
+{
+	SapStream *stream = config->stream;
+	if (stream && stream->count++ < stream->capacity)
+	{
+		SapOccurrence *occurrence = stream->occurrences + stream->count - 1;
+		occurrence->arg = i < config->argcount ? i : config->argcount;
+		occurrence->value = value;
+		occurrence->position = position;
+	}
+
+	if (i >= config->argcount) return 0; // an extra positional
+	const SapArgument *arg = config->arguments + i;
+	return (arg->callback
+			&& arg->callback(arg, value, position, arg->callback_data))
+		|| (config->callback
+			&& config->callback(arg, value, position, config->callback_data));
+}
+
+// builds required mask and one group mask per rule into masks, 1 if a rule
+// refers to a nonexistent argument
+/** @private */
+int _sap_build_masks(const SapConfig *config, SapWord *masks)
+{
+	unsigned int words = SAP_WORDS(config->argcount);
+	SAP_MEMSET(masks, 0, sizeof(SapWord) * words * (config->rulecount + 1));
+
+	// positional or required
+	for (unsigned int i = 0; i < config->argcount; i++)
+	{
+		SapArgument *arg = config->arguments + i;
+		if (arg->required || arg->type == SAP_ARG_POSITIONAL)
+			_sap_bit_set(masks, i, 1);
+	}
+
+	// groups of each rule
+	for (unsigned int r = 0; r < config->rulecount; r++)
+	{
+		SapRule *rule = config->rules + r;
+		SapWord *mask = masks + words * (r + 1);
+		if ((rule->type == SAP_RULE_CONFLICTS
+			|| rule->type == SAP_RULE_REQUIRES)
+			&& rule->arg >= config->argcount) return 1;
+		for (unsigned int k = 0; k < rule->groupcount; k++)
+		{
+			if (rule->group[k] >= config->argcount) return 1;
+			_sap_bit_set(mask, rule->group[k], 1);
+		}
+	}
+
+	return 0;
+}
+
+// records error of kind at token of index j about argument i in error, if
+// any, returning 1
+/** @private */
+int _sap_fail(SapError *error, SapErrorKind kind, int j, const char *text,
+	int i)
+{
+	if (!error) return 1;
+	error->kind = kind;
+	error->token = j;
+	error->text = text;
+	error->arg = i;
+	error->rule = -1;
+	return 1;
+}
+
+// checks required mask against set arguments, 1 if any are missing
+/** @private */
+int _sap_check_required(const SapWord *masks, const SapWord *set,
+	unsigned int words, SapError *error)
+{
+	for (unsigned int w = 0; w < words; w++)
+		if (masks[w] & ~set[w])
+			return _sap_fail(error, SAP_ERROR_REQUIRED, -1, NULL,
+				(int) (w * SAP_WORD_BITS + _sap_ctz(masks[w] & ~set[w])));
+	return 0;
+}
+
+// records rule r broken in error, if any, about argument i, returning 1
+/** @private */
+int _sap_fail_rule(SapError *error, unsigned int r, int i)
+{
+	_sap_fail(error, SAP_ERROR_RULE, -1, NULL, i);
+	if (error) error->rule = (int) r;
+	return 1;
+}
+
+// checks rules against set arguments, 1 if any are broken
+/** @private */
+int _sap_check_rules(const SapConfig *config, const SapWord *masks,
+	const SapWord *set, unsigned int words, SapError *error)
+{
+	for (unsigned int r = 0; r < config->rulecount; r++)
+	{
+		SapRule *rule = config->rules + r;
+		const SapWord *mask = masks + words * (r + 1);
+		unsigned int given = 0; // number of group given
+		unsigned int w;
+		switch (rule->type)
+		{
+		case SAP_RULE_CONFLICTS:
+			if (!_sap_bit_get(set, rule->arg)) break;
+			for (w = 0; w < words; w++)
+				if (mask[w] & set[w])
+					return _sap_fail_rule(error, r, (int) (w * SAP_WORD_BITS
+						+ _sap_ctz(mask[w] & set[w])));
+			break;
+		case SAP_RULE_REQUIRES:
+			if (!_sap_bit_get(set, rule->arg)) break;
+			for (w = 0; w < words; w++)
+				if (mask[w] & ~set[w])
+					return _sap_fail_rule(error, r, (int) (w * SAP_WORD_BITS
+						+ _sap_ctz(mask[w] & ~set[w])));
+			break;
+		case SAP_RULE_EXACTLY_ONE:
+			for (w = 0; w < words; w++)
+				given += _sap_popcount(mask[w] & set[w]);
+			if (given != 1) return _sap_fail_rule(error, r, -1);
+			break;
+		case SAP_RULE_AT_LEAST_ONE:
+			for (w = 0; w < words && !given; w++)
+				given = (mask[w] & set[w]) != 0;
+			if (!given) return _sap_fail_rule(error, r, -1);
+			break;
+		}
+	}
+	return 0;
+}
+
+// gets number of entries in choice tables of all arguments
+/** @private */
+size_t _sap_choice_tables_size(SapConfig config)
+{
+	size_t size = 0;
+	for (unsigned int i = 0; i < config.argcount; i++)
+		size += _sap_choice_table_size(config.arguments + i);
+	return size;
+}
+
+// puts argument i into the arrays by argument and the lookup tables of
+// compiled, other than those of choices
+/** @private */
+void _sap_compile_index(SapCompiled *compiled, const SapArgument *arg,
+	unsigned int i)
+{
+	compiled->types[i] = (unsigned char) arg->type;
+	compiled->shortopts[i] = 0;
+	compiled->hashes[i] = 0;
+	compiled->lengths[i] = 0;
+
+	// long options and names of positional arguments share a table, the
+	// first of any repeated ones winning, as when scanning
+	unsigned int h;
+	if (arg->longopt)
+	{
+		compiled->lengths[i] = (unsigned int) SAP_STRLEN(arg->longopt);
+		compiled->hashes[i] = _sap_hash_n(arg->longopt, compiled->lengths[i]);
+		h = compiled->hashes[i];
+		while (compiled->longtable[h & compiled->tablemask]) h++;
+		compiled->longtable[h & compiled->tablemask] = i + 1;
+	}
+	if (arg->type == SAP_ARG_POSITIONAL) return;
+
+	unsigned int shortopt = _sap_shortopt(arg);
+	compiled->shortopts[i] = shortopt;
+	if (shortopt < SAP_SHORT_TABLE)
+	{
+		if (!compiled->shorttable[shortopt])
+			compiled->shorttable[shortopt] = i + 1;
+	}
+	else
+	{
+		unsigned int *slot;
+		h = _sap_hash_short(shortopt);
+		while (*(slot = compiled->widetable + (h & compiled->tablemask))
+			&& compiled->shortopts[*slot - 1] != shortopt)
+			h++;
+		if (!*slot) *slot = i + 1;
+	}
+}
+
+size_t sap_compile_size(SapConfig config)
+{
+	return sizeof(SapCompiled)
+		+ sizeof(SapWord) * SAP_WORDS(config.argcount) * (config.rulecount + 1)
+		+ sizeof(unsigned int) * (4 * config.argcount
+			+ 2 * _sap_table_size(config.argcount) + SAP_SHORT_TABLE
+			+ _sap_choice_tables_size(config))
+		+ sizeof(unsigned char) * config.argcount;
+}
+
+int sap_compile(SapConfig *config, void *memory, size_t size)
+{
+	if (size < sap_compile_size(*config)) return 1;
+
+	// split up memory, largest alignment first
+	unsigned int words = SAP_WORDS(config->argcount);
+	unsigned int tablesize = _sap_table_size(config->argcount);
+	SapCompiled *compiled = (SapCompiled *) memory;
+	compiled->words = words;
+	compiled->tablemask = tablesize - 1;
+	compiled->rulecount = config->rulecount;
+	compiled->masks = (SapWord *) (compiled + 1);
+	compiled->shortopts = (unsigned int *) (compiled->masks
+		+ words * (config->rulecount + 1));
+	compiled->hashes = compiled->shortopts + config->argcount;
+	compiled->lengths = compiled->hashes + config->argcount;
+	compiled->longtable = compiled->lengths + config->argcount;
+	compiled->widetable = compiled->longtable + tablesize;
+	compiled->shorttable = compiled->widetable + tablesize;
+	compiled->choiceoffsets = compiled->shorttable + SAP_SHORT_TABLE;
+	compiled->choicetables = compiled->choiceoffsets + config->argcount;
+	compiled->types = (unsigned char *) (compiled->choicetables
+		+ _sap_choice_tables_size(*config));
+	if (_sap_build_masks(config, compiled->masks)) return 1;
+
+	SAP_MEMSET(compiled->longtable, 0, sizeof(unsigned int) * tablesize);
+	SAP_MEMSET(compiled->widetable, 0, sizeof(unsigned int) * tablesize);
+	SAP_MEMSET(compiled->shorttable, 0, sizeof(unsigned int) * SAP_SHORT_TABLE);
+	unsigned int offset = 0; // into choicetables
+	for (unsigned int i = 0; i < config->argcount; i++)
+	{
+		SapArgument *arg = config->arguments + i;
+		_sap_compile_index(compiled, arg, i);
+
+		// choices with no perfect hash, such as repeated ones, are searched
+		// in order instead
+		compiled->choiceoffsets[i] = 0;
+		if (_sap_choice_table_size(arg))
+		{
+			if (!_sap_build_choices(arg, compiled->choicetables + offset))
+				compiled->choiceoffsets[i] = offset + 1;
+			offset += _sap_choice_table_size(arg);
+		}
+	}
+
+	config->compiled = compiled;
+	return 0;
+}
+
+// sets all arguments to not set, only those in set if it is the bitset of
+// the configuration, and clears set
+/** @private */
+void _sap_clear(SapConfig *config, SapWord *set)
+{
+	unsigned int words = SAP_WORDS(config->argcount);
+	if (set == config->setbits)
+	{
+		for (unsigned int w = 0; w < words; w++)
+			for (; set[w]; set[w] &= set[w] - 1)
+			{
+				SapArgument *arg = config->arguments + w * SAP_WORD_BITS
+					+ _sap_ctz(set[w]);
+				arg->set = 0;
+				arg->count = 0;
+			}
+	}
+	else
+	{
+		for (unsigned int i = 0; i < config->argcount; i++)
+		{
+			config->arguments[i].set = 0;
+			config->arguments[i].count = 0;
+		}
+		SAP_MEMSET(set, 0, sizeof(SapWord) * words);
+	}
+}
+
+int sap_parse_args(SapConfig config, int argc, char **argv)
+{
+	return sap_parse(config, argc, argv, NULL);
+}
+
+// token of argv classified ahead of the parse by sap_parse_parallel()
+/** @private */
+typedef struct SapClassified
+{
+	int kind; // ARG_* classification
+	int arg; // option of the token, or its first short option, -1 if none
+	int choice; // choice of the token as value of the option before it, or
+	            // of the value attached to it
+	int attached; // offset of value attached after '=' into token, 0 if none
+} SapClassified;
+
+// advances cursor to next token
+/** @private */
+void _sap_cursor_next(SapCursor *cursor)
+{
+	cursor->j++;
+	if (cursor->argv)
+		cursor->token = cursor->j < cursor->argc ? cursor->argv[cursor->j]
+			: NULL;
+	else if (cursor->token)
+	{
+		cursor->token += _sap_scan(cursor->token,
+			cursor->end - cursor->token).length + 1;
+		if (cursor->token >= cursor->end) cursor->token = NULL;
+	}
+}
+
+// gets token after the current one, NULL if none
+/** @private */
+const char *_sap_cursor_peek(const SapCursor *cursor)
+{
+	if (cursor->argv)
+		return cursor->j + 1 < cursor->argc ? cursor->argv[cursor->j + 1]
+			: NULL;
+	const char *next = cursor->token + _sap_scan(cursor->token,
+		cursor->end - cursor->token).length + 1;
+	return next < cursor->end ? next : NULL;
+}
+
+// gets ARG_* classification of token, the current one or the one after it
+/** @private */
+int _sap_cursor_kind(const SapCursor *cursor, int ahead, const char *token,
+	unsigned int flags)
+{
+	return cursor->classified ? cursor->classified[cursor->j + ahead].kind
+		: _sap_check_arg_type(token, flags);
+}
+
+// sets value of valued option i to value, in or attached to token j, 1 if it
+// is not one of its choices
+/** @private */
+int _sap_cursor_value(const SapConfig *config, const SapCursor *cursor,
+	unsigned int i, const char *value, int j)
+{
+	if (!cursor->classified) return _sap_set_value(config, i, value);
+	SapArgument *arg = config->arguments + i;
+	arg->value = value;
+	if (!arg->choicecount) return 0;
+	arg->choice = cursor->classified[j].choice;
+	return arg->choice < 0;
+}
+
+void _sap_walk_start(SapWalk *walk, const SapConfig *config,
+	const SapCursor *cursor)
+{
+	walk->config = config;
+	walk->cursor = *cursor;
+	walk->k = 0;
+	walk->positional = _sap_next_positional(config, 0);
+	walk->stop = 0;
+	_sap_cursor_next(&walk->cursor); // skip argv[0]
+}
+
+// ends walk with error kind at the current token, for argument i
+/** @private */
+int _sap_walk_fail(SapWalk *walk, SapStep *step, SapErrorKind kind, int i)
+{
+	step->arg = i;
+	step->token = walk->cursor.token;
+	step->position = walk->cursor.j;
+	step->error = kind;
+	walk->cursor.token = NULL; // nothing more to walk
+	return 0;
+}
+
+// finds argument i at token j, taking value from the token after it if valued
+// and value is NULL, 1 if found
+/** @private */
+int _sap_walk_found(SapWalk *walk, SapStep *step, int i, const char *value)
+{
+	SapCursor *cursor = &walk->cursor;
+	step->arg = i;
+	step->token = cursor->token;
+	step->position = cursor->j;
+	step->value = value;
+	step->valuetoken = cursor->j;
+	if (!value && i < (int) walk->config->argcount
+		&& walk->config->arguments[i].type == SAP_ARG_OPTION_VALUE)
+	{
+		// no value given
+		const char *next = _sap_cursor_peek(cursor);
+		if (!next || _sap_cursor_kind(cursor, 1, next, walk->config->flags)
+			!= ARG_NORMAL)
+			return _sap_walk_fail(walk, step, SAP_ERROR_MISSING_VALUE, i);
+
+		// take value and skip over it
+		_sap_cursor_next(cursor);
+		step->value = next;
+		step->valuetoken = cursor->j;
+	}
+	_sap_cursor_next(cursor);
+	return 1;
+}
+
+int _sap_walk_next(SapWalk *walk, SapStep *step)
+{
+	const SapConfig *config = walk->config;
+	SapCursor *cursor = &walk->cursor;
+	step->arg = -1;
+	step->error = SAP_ERROR_NONE;
+	while (cursor->token)
+	{
+		const char *token = cursor->token, *value;
+		int i;
+		unsigned int k, n, shortopt;
+
+		// after the end of options, only positional arguments left unset are
+		// taken, leaving the rest as the tail
+		if (walk->stop && walk->positional >= config->argcount) return 0;
+		switch (walk->stop ? ARG_NORMAL : walk->k ? ARG_SHORTOPT
+			: _sap_cursor_kind(cursor, 0, token, config->flags))
+		{
+		case ARG_SHORTOPT: // short options, k being the next character
+			if (!walk->k) walk->k = 1;
+			while ((n = _sap_next_short(token + (k = walk->k), &shortopt)))
+			{
+				walk->k += n;
+				i = k == 1 && cursor->classified
+					? cursor->classified[cursor->j].arg
+					: _sap_find_short(config, shortopt);
+				if (i < 0 && (config->flags & SAP_FLAG_STRICT))
+					return _sap_walk_fail(walk, step, SAP_ERROR_UNKNOWN, -1);
+				if (i < 0) continue; // not an option of ours
+				if (config->arguments[i].type != SAP_ARG_OPTION_VALUE)
+				{
+					step->arg = i;
+					step->token = token;
+					step->position = cursor->j;
+					step->value = NULL;
+					step->valuetoken = cursor->j;
+					return 1;
+				}
+
+				// too many options set for valued option
+				walk->k = 0;
+				if (k > 1 || token[k + n] != '\0')
+					return _sap_walk_fail(walk, step, SAP_ERROR_CLUSTER, i);
+				return _sap_walk_found(walk, step, i, NULL);
+			}
+			walk->k = 0;
+			break;
+		case ARG_LONGOPT: // long option
+			if (cursor->classified)
+			{
+				i = cursor->classified[cursor->j].arg;
+				value = cursor->classified[cursor->j].attached
+					? token + cursor->classified[cursor->j].attached : NULL;
+			}
+			else i = _sap_find_long(config, token + 2, cursor->argv
+				? (size_t) -1 : (size_t) (cursor->end - token - 2), &value);
+			if (i < 0 && (config->flags & SAP_FLAG_STRICT))
+				return _sap_walk_fail(walk, step, SAP_ERROR_UNKNOWN, -1);
+			if (i < 0) break; // not an option of ours
+
+			// value attached after '=', only to valued options
+			if (value && config->arguments[i].type != SAP_ARG_OPTION_VALUE)
+				return _sap_walk_fail(walk, step, SAP_ERROR_UNWANTED_VALUE, i);
+			return _sap_walk_found(walk, step, i, value);
+		case ARG_NORMAL: // positional, ending options if asked to
+			if (!walk->stop && (config->flags & SAP_FLAG_STOP))
+			{
+				walk->stop = 1; // look at this token again as tail
+				continue;
+			}
+			i = walk->positional;
+			if (walk->positional < config->argcount)
+				walk->positional = _sap_next_positional(config,
+					walk->positional + 1);
+			return _sap_walk_found(walk, step, i, token);
+		case ARG_ERROR: // error
+			return _sap_walk_fail(walk, step, SAP_ERROR_MALFORMED, -1);
+		case ARG_END: // end of options
+			walk->stop = 1;
+			break;
+		}
+		_sap_cursor_next(cursor);
+	}
+	return 0;
+}
+
+// parses tokens from cursor, which is at argv[0], leaving it at the first
+// token of the tail
+/** @private */
+int _sap_parse(SapConfig config, SapCursor *cursor, SapError *error)
+{
+	_sap_fail(error, SAP_ERROR_NONE, -1, NULL, -1); // no error so far
+
+	// bitset of arguments set, checked against constraints at the end, kept
+	// with the arguments if given so that the next parse knows which to
+	// clear
+	unsigned int words = SAP_WORDS(config.argcount);
+	SapWord local[config.setbits ? 1 : words + 1];
+	SapWord *set = config.setbits ? config.setbits : local;
+
+	// set all arguments to not set
+	_sap_clear(&config, set);
+	if (config.stream) config.stream->count = 0;
+
+	// walk through tokens once, setting the argument each refers to
+	SapWalk walk;
+	SapStep step;
+	_sap_walk_start(&walk, &config, cursor);
+	while (_sap_walk_next(&walk, &step))
+	{
+		unsigned int i = step.arg;
+		if (i < config.argcount)
+		{
+			SapArgument *arg = config.arguments + i;
+			arg->set = 1;
+			_sap_bit_set(set, i, 1);
+			if (arg->type == SAP_ARG_POSITIONAL)
+			{
+				arg->value = step.value;
+				arg->count = 1;
+			}
+			else
+			{
+				arg->count++;
+				if (step.value && _sap_cursor_value(&config, &walk.cursor, i,
+					step.value, step.valuetoken))
+					return _sap_fail(error, SAP_ERROR_CHOICE, step.valuetoken,
+						step.value, i);
+			}
+		}
+		if (_sap_match(&config, i, step.value, step.position))
+			return _sap_fail(error, SAP_ERROR_CALLBACK, step.position,
+				step.token, i);
+	}
+	if (step.error)
+		return _sap_fail(error, step.error, step.position, step.token,
+			step.arg);
+	*cursor = walk.cursor;
+
+	// masks of constraints, compiled now if not done beforehand
+	const SapWord *masks;
+	SapWord built[config.compiled ? 1 : words * (config.rulecount + 1) + 1];
+	if (config.compiled && config.compiled->rulecount != config.rulecount)
+		return _sap_fail(error, SAP_ERROR_CONFIG, -1, NULL, -1);
+	else if (config.compiled) masks = config.compiled->masks;
+	else if (_sap_build_masks(&config, built))
+		return _sap_fail(error, SAP_ERROR_CONFIG, -1, NULL, -1);
+	else masks = built;
+
+	// check all required arguments are fulfilled and rules hold
+	return _sap_check_required(masks, set, words, error)
+		|| _sap_check_rules(&config, masks, set, words, error);
+}
+
+// copies string s to *p, or only counts it if copy is 0, returning the copy
+/** @private */
+char *_sap_arena_string(char **p, size_t *used, const char *s, int copy)
+{
+	size_t length = SAP_STRLEN(s) + 1;
+	char *to = *p;
+	*used += length;
+	if (!copy) return NULL;
+	SAP_MEMCPY(to, s, length);
+	*p += length;
+	return to;
+}
+
+// copies what the parse left pointing into the command line into config.arena
+// in two passes, counting then copying, 1 if it does not fit
+/** @private */
+int _sap_arena_copy(const SapConfig *config, SapResult *result)
+{
+	SapArena *arena = config->arena;
+	SapStream *stream = config->stream;
+	unsigned int occurrences = !stream ? 0 : stream->count < stream->capacity
+		? stream->count : stream->capacity;
+	for (int copy = 0; copy < 2; copy++)
+	{
+		char *p = (char *) arena->memory;
+		size_t used = 0;
+
+		// pointers first, keeping them aligned
+		if (result && result->tail_argv)
+		{
+			char **tail = (char **) p;
+			used += (result->tail_argc + 1) * sizeof(char *);
+			if (copy)
+			{
+				p += used;
+				for (int j = 0; j < result->tail_argc; j++)
+					tail[j] = _sap_arena_string(&p, &used,
+						result->tail_argv[j], 1);
+				tail[result->tail_argc] = NULL;
+				result->tail_argv = tail;
+			}
+			else
+				for (int j = 0; j < result->tail_argc; j++)
+					_sap_arena_string(&p, &used, result->tail_argv[j], 0);
+		}
+		else if (result && result->tail_buffer)
+		{
+			if (copy && result->tail_size)
+			{
+				SAP_MEMCPY(p, result->tail_buffer, result->tail_size);
+				result->tail_buffer = p;
+				p += result->tail_size;
+			}
+			used += result->tail_size;
+		}
+
+		// an occurrence holding the value of its argument moves it along
+		SapWord moved[SAP_WORDS(config->argcount) + 1];
+		SAP_MEMSET(moved, 0, sizeof(moved));
+		for (unsigned int m = 0; m < occurrences; m++)
+		{
+			SapOccurrence *occurrence = stream->occurrences + m;
+			if (!occurrence->value) continue;
+			SapArgument *arg = occurrence->arg < config->argcount
+				? config->arguments + occurrence->arg : NULL;
+			if (arg && arg->set && occurrence->value == arg->value
+				&& !_sap_bit_get(moved, occurrence->arg))
+			{
+				_sap_bit_set(moved, occurrence->arg, 1);
+				if (!copy) continue;
+				arg->value = _sap_arena_string(&p, &used, arg->value, 1);
+				occurrence->value = arg->value;
+			}
+			else
+			{
+				char *to = _sap_arena_string(&p, &used, occurrence->value,
+					copy);
+				if (copy) occurrence->value = to;
+			}
+		}
+		for (unsigned int i = 0; i < config->argcount; i++)
+		{
+			SapArgument *arg = config->arguments + i;
+			if (arg->set && arg->value && (!copy || !_sap_bit_get(moved, i)))
+			{
+				char *to = _sap_arena_string(&p, &used, arg->value, copy);
+				if (copy) arg->value = to;
+			}
+		}
+		if (copy) break;
+
+		arena->used = used;
+		if (used <= arena->size) continue;
+#ifndef SAP_FREESTANDING
+		if (arena->grow)
+		{
+			void *memory = realloc(arena->memory, used);
+			if (memory)
+			{
+				arena->memory = memory;
+				arena->size = used;
+				continue;
+			}
+		}
+#endif
+		return 1;
+	}
+	return 0;
+}
+
+// parses argv as sap_parse(), with tokens classified beforehand if
+// classified is not NULL
+/** @private */
+int _sap_parse_argv(SapConfig config, int argc, char **argv,
+	SapResult *result, const SapClassified *classified)
+{
+	SapCursor cursor = { argv, argc, 0, argc > 0 ? argv[0] : NULL, NULL,
+		classified };
+	SapError local;
+	SapError *error = result ? &result->error : &local;
+	int status = _sap_parse(config, &cursor, error);
+	if (result)
+	{
+		int tail = status == 0 && cursor.j < argc ? cursor.j : argc;
+		result->tail_argc = argc - tail;
+		result->tail_argv = argv + tail;
+		result->tail_buffer = NULL;
+		result->tail_size = 0;
+	}
+	if (config.arena && _sap_arena_copy(&config, result) && !status)
+		return _sap_fail(error, SAP_ERROR_MEMORY, -1, NULL, -1);
+	return status;
+}
+
+int sap_parse(SapConfig config, int argc, char **argv, SapResult *result)
+{
+	return _sap_parse_argv(config, argc, argv, result, NULL);
+}
+
+// chunk of argv classified by one thread
+/** @private */
+typedef struct SapChunk
+{
+	const SapConfig *config;
+	char **argv;
+	SapClassified *classified; // where to classify the chunk into
+	int from; // first token of the chunk
+	int to; // token after the last
+} SapChunk;
+
+// classifies token, looking up its option, or first short option, if it has
+// one; the choice is left to the token after it
+/** @private */
+SapClassified _sap_classify(const SapConfig *config, const char *token)
+{
+	SapClassified classified = { _sap_check_arg_type(token, config->flags),
+		-1, -1, 0 };
+	unsigned int shortopt;
+	const char *value;
+	if (classified.kind == ARG_LONGOPT)
+	{
+		classified.arg = _sap_find_long(config, token + 2, (size_t) -1,
+			&value);
+		if (value && classified.arg >= 0)
+		{
+			classified.attached = (int) (value - token);
+			if (config->arguments[classified.arg].choicecount)
+				classified.choice = _sap_find_choice(config, classified.arg,
+					value);
+		}
+	}
+	else if (classified.kind == ARG_SHORTOPT
+		&& _sap_next_short(token + 1, &shortopt))
+		classified.arg = _sap_find_short(config, shortopt);
+	return classified;
+}
+
+// classifies tokens of chunk, as a thread routine
+/** @private */
+void *_sap_classify_chunk(void *data)
+{
+	const SapChunk *chunk = (const SapChunk *) data;
+	const SapConfig *config = chunk->config;
+
+	// the token before the chunk, classified again, may make a value of the
+	// first one
+	SapClassified before = { ARG_NORMAL, -1, -1, 0 }; // argv[0]
+	if (chunk->from > 1)
+		before = _sap_classify(config, chunk->argv[chunk->from - 1]);
+	for (int j = chunk->from; j < chunk->to; j++)
+	{
+		SapClassified *classified = chunk->classified + j;
+		*classified = _sap_classify(config, chunk->argv[j]);
+		if (classified->kind == ARG_NORMAL && before.arg >= 0
+			&& !before.attached
+			&& (before.kind == ARG_LONGOPT || before.kind == ARG_SHORTOPT)
+			&& config->arguments[before.arg].choicecount)
+			classified->choice = _sap_find_choice(config, before.arg,
+				chunk->argv[j]);
+		before = *classified;
+	}
+	return NULL;
+}
+
+size_t sap_parse_parallel_size(int argc)
+{
+	return (argc > 0 ? argc : 0) * sizeof(SapClassified);
+}
+
+int sap_parse_parallel(SapConfig config, int argc, char **argv,
+	SapResult *result, unsigned int threads, void *memory, size_t size)
+{
+	if (size < sap_parse_parallel_size(argc))
+		return _sap_fail(result ? &result->error : NULL, SAP_ERROR_MEMORY,
+			-1, NULL, -1);
+	SapClassified *classified = (SapClassified *) memory;
+
+	// chunks of tokens after argv[0], as even as can be
+	if (threads < 1) threads = 1;
+	if (threads > SAP_PARALLEL_THREADS) threads = SAP_PARALLEL_THREADS;
+	if (argc > 1 && threads > (unsigned int) argc - 1) threads = argc - 1;
+	SapChunk chunks[SAP_PARALLEL_THREADS];
+	for (unsigned int t = 0; t < threads; t++)
+	{
+		chunks[t].config = &config;
+		chunks[t].argv = argv;
+		chunks[t].classified = classified;
+		chunks[t].from = 1 + (int) ((argc > 1 ? argc - 1 : 0)
+			* (unsigned long long) t / threads);
+		chunks[t].to = 1 + (int) ((argc > 1 ? argc - 1 : 0)
+			* (unsigned long long) (t + 1) / threads);
+	}
+
+	// the calling thread takes the first chunk, and those it could not start
+#if defined(__linux__) && !defined(SAP_FREESTANDING) && defined(SAP_THREADS)
+	pthread_t workers[SAP_PARALLEL_THREADS];
+	int started[SAP_PARALLEL_THREADS];
+	for (unsigned int t = 1; t < threads; t++)
+		started[t] = pthread_create(&workers[t], NULL, _sap_classify_chunk,
+			&chunks[t]) == 0;
+	_sap_classify_chunk(&chunks[0]);
+	for (unsigned int t = 1; t < threads; t++)
+	{
+		if (started[t]) pthread_join(workers[t], NULL);
+		else _sap_classify_chunk(&chunks[t]);
+	}
+#else
+	for (unsigned int t = 0; t < threads; t++)
+		_sap_classify_chunk(&chunks[t]);
+#endif
+
+	return _sap_parse_argv(config, argc, argv, result, classified);
+}
+
+int sap_parse_buffer(SapConfig config, const char *buffer, size_t size,
+	SapResult *result)
+{
+	SapCursor cursor = { NULL, 0, 0, size > 0 ? buffer : NULL,
+		buffer + size, NULL };
+	SapError local;
+	SapError *error = result ? &result->error : &local;
+	int status = _sap_parse(config, &cursor, error);
+	if (result)
+	{
+		const char *tail = status == 0 && cursor.token ? cursor.token
+			: buffer + size;
+		result->tail_argc = 0;
+		result->tail_argv = NULL;
+		result->tail_buffer = tail;
+		result->tail_size = buffer + size - tail;
+		for (; tail < buffer + size; tail += SAP_STRLEN(tail) + 1)
+			result->tail_argc++;
+	}
+	if (config.arena && _sap_arena_copy(&config, result) && !status)
+		return _sap_fail(error, SAP_ERROR_MEMORY, -1, NULL, -1);
+	return status;
+}
+
+// command line being rebuilt, only counted if argv is NULL
+/** @private */
+typedef struct SapBuilder
+{
+	char **argv; // tokens written, NULL if counting
+	char *text; // where the next token is copied to
+	int argc; // number of tokens so far
+	size_t textsize; // bytes of tokens so far, including NULs
+} SapBuilder;
+
+// adds token made of prefix followed by s, then '=' and value unless NULL
+/** @private */
+void _sap_build_token(SapBuilder *builder, const char *prefix, const char *s,
+	const char *value)
+{
+	size_t prefixlength = SAP_STRLEN(prefix), length = SAP_STRLEN(s) + 1;
+	size_t valuelength = value ? SAP_STRLEN(value) + 1 : 0;
+	if (builder->argv)
+	{
+		builder->argv[builder->argc] = builder->text;
+		SAP_MEMCPY(builder->text, prefix, prefixlength);
+		SAP_MEMCPY(builder->text + prefixlength, s, length);
+		builder->text += prefixlength + length;
+		if (value)
+		{
+			builder->text[-1] = '=';
+			SAP_MEMCPY(builder->text, value, valuelength);
+			builder->text += valuelength;
+		}
+	}
+	builder->argc++;
+	builder->textsize += prefixlength + length + valuelength;
+}
+
+// adds token giving option, by its long option or else its short option, with
+// value attached after '=' unless NULL, 1 if it cannot be given that way
+/** @private */
+int _sap_build_option(SapBuilder *builder, const SapArgument *arg,
+	const char *value)
+{
+	if (arg->longopt)
+	{
+		_sap_build_token(builder, "--", arg->longopt, value);
+		return 0;
+	}
+	char shortopt[5];
+	if (!_sap_shortopt(arg) || value) return 1;
+	_sap_encode_short(_sap_shortopt(arg), shortopt);
+	_sap_build_token(builder, "-", shortopt, NULL);
+	return 0;
+}
+
+// gets whether argument i is set and its count and value, after overrides
+/** @private */
+int _sap_build_arg(const SapConfig *config, unsigned int i,
+	const SapOverride *overrides, unsigned int overridecount,
+	unsigned int *count, const char **value)
+{
+	const SapArgument *arg = config->arguments + i;
+	int set = arg->set;
+	*count = set ? arg->count : 0;
+	*value = set ? arg->value : NULL;
+	for (unsigned int o = 0; o < overridecount; o++)
+		if (overrides[o].arg == i)
+		{
+			set = overrides[o].set;
+			*count = set ? (*count ? *count : 1) : 0;
+			*value = set ? overrides[o].value : NULL;
+		}
+	return set;
+}
+
+// adds tokens of command line with overrides to builder, 1 if an option cannot
+// be given
+/** @private */
+int _sap_build(const SapConfig *config, const char *argv0,
+	const SapResult *result, const SapOverride *overrides,
+	unsigned int overridecount, SapBuilder *builder)
+{
+	unsigned int i, count;
+	const char *value;
+	_sap_build_token(builder, "", argv0, NULL);
+
+	// options first, working out whether -- is needed on the way
+	int end = result && result->tail_argc > 0;
+	for (i = 0; i < config->argcount; i++)
+	{
+		const SapArgument *arg = config->arguments + i;
+		if (!_sap_build_arg(config, i, overrides, overridecount, &count,
+			&value)) continue;
+
+		switch (arg->type)
+		{
+		case SAP_ARG_OPTION:
+			for (unsigned int k = 0; k < count; k++)
+				if (_sap_build_option(builder, arg, NULL)) return 1;
+			break;
+		case SAP_ARG_OPTION_VALUE:
+			// attached if it would not be taken as a value on its own
+			if (!value) return 1;
+			if (_sap_check_arg_type(value, config->flags) != ARG_NORMAL)
+			{
+				if (_sap_build_option(builder, arg, value)) return 1;
+				break;
+			}
+			if (_sap_build_option(builder, arg, NULL)) return 1;
+			_sap_build_token(builder, "", value, NULL);
+			break;
+		case SAP_ARG_POSITIONAL:
+			if (value
+				&& _sap_check_arg_type(value, config->flags) != ARG_NORMAL)
+				end = 1;
+			break;
+		}
+	}
+	if (end) _sap_build_token(builder, "", "--", NULL);
+
+	// then positional arguments
+	for (i = _sap_next_positional(config, 0); i < config->argcount;
+		i = _sap_next_positional(config, i + 1))
+		if (_sap_build_arg(config, i, overrides, overridecount, &count,
+			&value) && value)
+			_sap_build_token(builder, "", value, NULL);
+
+	// then the tail, from argv or a buffer
+	if (result && result->tail_argv)
+		for (int j = 0; j < result->tail_argc; j++)
+			_sap_build_token(builder, "", result->tail_argv[j], NULL);
+	else if (result && result->tail_buffer)
+		for (const char *token = result->tail_buffer;
+			token < result->tail_buffer + result->tail_size;
+			token += SAP_STRLEN(token) + 1)
+			_sap_build_token(builder, "", token, NULL);
+	return 0;
+}
+
+size_t sap_build_argv_size(SapConfig config, const char *argv0,
+	const SapResult *result, const SapOverride *overrides,
+	unsigned int overridecount)
+{
+	SapBuilder builder = { NULL, NULL, 0, 0 };
+	_sap_build(&config, argv0, result, overrides, overridecount, &builder);
+	return sizeof(char *) * (builder.argc + 1) + builder.textsize;
+}
+
+char **sap_build_argv(SapConfig config, const char *argv0,
+	const SapResult *result, const SapOverride *overrides,
+	unsigned int overridecount, void *memory, size_t size, int *argc)
+{
+	// count first, to place the strings after the pointers
+	SapBuilder builder = { NULL, NULL, 0, 0 };
+	if (_sap_build(&config, argv0, result, overrides, overridecount,
+		&builder)
+		|| size < sizeof(char *) * (builder.argc + 1) + builder.textsize)
+		return NULL;
+
+	builder.argv = (char **) memory;
+	builder.text = (char *) (builder.argv + builder.argc + 1);
+	builder.argc = 0;
+	_sap_build(&config, argv0, result, overrides, overridecount, &builder);
+	builder.argv[builder.argc] = NULL;
+	if (argc) *argc = builder.argc;
+	return builder.argv;
+}
+
+// writes string through callback, nothing if NULL
+/** @private */
+void _sap_write_string(SapWriteCallback write, void *data, const char *s)
+{
+	if (s) write(s, SAP_STRLEN(s), data);
+}
+
+// writes number in decimal through callback
+/** @private */
+void _sap_write_number(SapWriteCallback write, void *data, unsigned int n)
+{
+	char digits[10];
+	unsigned int k = sizeof(digits);
+	do digits[--k] = (char) ('0' + n % 10);
+	while (n /= 10);
+	write(digits + k, sizeof(digits) - k, data);
+}
+
+// writes line of help of argument
+/** @private */
+void _sap_write_entry(SapWriteCallback write, void *data,
+	const SapArgument *arg)
+{
+	if (arg->type == SAP_ARG_POSITIONAL)
+	{
+		_sap_write_string(write, data, "\t");
+		_sap_write_string(write, data, arg->longopt);
+		_sap_write_string(write, data, " ");
+		_sap_write_string(write, data, arg->help);
+		_sap_write_string(write, data, "\n");
+		return;
+	}
+
+	char shortopt[5];
+	_sap_encode_short(_sap_shortopt(arg), shortopt);
+	_sap_write_string(write, data, "\t-");
+	_sap_write_string(write, data, shortopt);
+	_sap_write_string(write, data, ", --");
+	_sap_write_string(write, data, arg->longopt);
+	_sap_write_string(write, data, " ");
+	_sap_write_string(write, data, arg->help);
+	if (arg->default_value)
+	{
+		_sap_write_string(write, data, " [default: ");
+		_sap_write_string(write, data, arg->default_value);
+		_sap_write_string(write, data, "]");
+	}
+	if (arg->type == SAP_ARG_OPTION_VALUE && arg->choicecount)
+	{
+		_sap_write_string(write, data, " [possible values: ");
+		for (unsigned int c = 0; c < arg->choicecount; c++)
+		{
+			if (c) _sap_write_string(write, data, ", ");
+			_sap_write_string(write, data, arg->choices[c]);
+		}
+		_sap_write_string(write, data, "]");
+	}
+	_sap_write_string(write, data, "\n");
+}
+
+void sap_write_help(SapConfig config, SapWriteCallback write, void *data)
+{
+	// writes metadata
+	_sap_write_string(write, data, config.name);
+	_sap_write_string(write, data, " ");
+	_sap_write_number(write, data, config.version_major);
+	_sap_write_string(write, data, ".");
+	_sap_write_number(write, data, config.version_minor);
+	_sap_write_string(write, data, ".");
+	_sap_write_number(write, data, config.version_patch);
+	_sap_write_string(write, data, "\n");
+	_sap_write_string(write, data, config.author);
+	_sap_write_string(write, data, "\n");
+	_sap_write_string(write, data, config.about);
+	_sap_write_string(write, data, "\n\n");
+
+	// writes usage
+	_sap_write_string(write, data, "USAGE:\n\t");
+	_sap_write_string(write, data, config.name);
+	_sap_write_string(write, data, " [FLAGS] ");
+
+	// iterate through arguments to write usage
+	for (unsigned int i = 0; i < config.argcount; i++)
+	{
+		SapArgument arg = config.arguments[i];
+		if (arg.type == SAP_ARG_POSITIONAL)
+		{
+			if (arg.required)
+			{
+				_sap_write_string(write, data, arg.longopt);
+				_sap_write_string(write, data, " ");
+			}
+			else
+			{
+				_sap_write_string(write, data, "[");
+				_sap_write_string(write, data, arg.longopt);
+				_sap_write_string(write, data, "] ");
+			}
+		}
+	}
+	_sap_write_string(write, data, "\n\n");
+
+	// writes flags, under their sections if any
+	unsigned int sections = config.sectioncount ? config.sectioncount : 1;
+	for (unsigned int section = 0; section < sections; section++)
+	{
+		_sap_write_string(write, data, config.sectioncount
+			? config.sections[section] : "FLAGS");
+		_sap_write_string(write, data, ":\n");
+		for (unsigned int i = 0; i < config.argcount; i++)
+		{
+			const SapArgument *arg = config.arguments + i;
+			if (arg->type != SAP_ARG_POSITIONAL
+				&& (!config.sectioncount || arg->section == section))
+				_sap_write_entry(write, data, arg);
+		}
+		_sap_write_string(write, data, "\n");
+	}
+
+	// writes arguments
+	_sap_write_string(write, data, "ARGUMENTS:\n");
+	for (unsigned int i = 0; i < config.argcount; i++)
+		if (config.arguments[i].type == SAP_ARG_POSITIONAL)
+			_sap_write_entry(write, data, config.arguments + i);
+}
+
+// writes argument i as given on the command line, by long option, or by name
+// if positional
+/** @private */
+void _sap_write_arg(const SapConfig *config, SapWriteCallback write,
+	void *data, int i)
+{
+	const SapArgument *arg = config->arguments + i;
+	if (arg->type != SAP_ARG_POSITIONAL) _sap_write_string(write, data, "--");
+	_sap_write_string(write, data, arg->longopt);
+}
+
+// writes text of error quoted
+/** @private */
+void _sap_write_quoted(SapWriteCallback write, void *data, const char *text)
+{
+	_sap_write_string(write, data, "'");
+	_sap_write_string(write, data, text);
+	_sap_write_string(write, data, "'");
+}
+
+void sap_write_error(SapConfig config, const SapError *error,
+	SapWriteCallback write, void *data)
+{
+	if (error->kind == SAP_ERROR_NONE) return;
+	_sap_write_string(write, data, config.name);
+	_sap_write_string(write, data, ": ");
+	const SapRule *rule = error->rule >= 0 ? config.rules + error->rule
+		: NULL;
+	switch (error->kind)
+	{
+	case SAP_ERROR_NONE:
+		break;
+	case SAP_ERROR_MALFORMED:
+		_sap_write_string(write, data, "malformed option ");
+		_sap_write_quoted(write, data, error->text);
+		break;
+	case SAP_ERROR_MISSING_VALUE:
+		_sap_write_string(write, data, "missing value for ");
+		_sap_write_arg(&config, write, data, error->arg);
+		break;
+	case SAP_ERROR_CLUSTER:
+		_sap_write_arg(&config, write, data, error->arg);
+		_sap_write_string(write, data, " takes a value and must be given "
+			"alone, not in ");
+		_sap_write_quoted(write, data, error->text);
+		break;
+	case SAP_ERROR_UNWANTED_VALUE:
+		_sap_write_arg(&config, write, data, error->arg);
+		_sap_write_string(write, data, " takes no value, given ");
+		_sap_write_quoted(write, data, error->text);
+		break;
+	case SAP_ERROR_CHOICE:
+		_sap_write_string(write, data, "invalid value ");
+		_sap_write_quoted(write, data, error->text);
+		_sap_write_string(write, data, " for ");
+		_sap_write_arg(&config, write, data, error->arg);
+		break;
+	case SAP_ERROR_CALLBACK:
+		_sap_write_string(write, data, "rejected ");
+		_sap_write_arg(&config, write, data, error->arg);
+		break;
+	case SAP_ERROR_REQUIRED:
+		_sap_write_string(write, data, "missing ");
+		_sap_write_arg(&config, write, data, error->arg);
+		break;
+	case SAP_ERROR_RULE:
+		if (rule->type == SAP_RULE_CONFLICTS
+			|| rule->type == SAP_RULE_REQUIRES)
+		{
+			_sap_write_arg(&config, write, data, (int) rule->arg);
+			_sap_write_string(write, data, rule->type == SAP_RULE_CONFLICTS
+				? " may not be given with " : " must be given with ");
+			_sap_write_arg(&config, write, data, error->arg);
+			break;
+		}
+		_sap_write_string(write, data, rule->type == SAP_RULE_EXACTLY_ONE
+			? "exactly one of " : "at least one of ");
+		for (unsigned int g = 0; g < rule->groupcount; g++)
+		{
+			if (g) _sap_write_string(write, data, ", ");
+			_sap_write_arg(&config, write, data, (int) rule->group[g]);
+		}
+		_sap_write_string(write, data, " must be given");
+		break;
+	case SAP_ERROR_CONFIG:
+		_sap_write_string(write, data, "rule refers to nonexistent argument");
+		break;
+	case SAP_ERROR_MEMORY:
+		_sap_write_string(write, data, "memory given to parse too small");
+		break;
+	case SAP_ERROR_UNKNOWN:
+		_sap_write_string(write, data, "unknown option ");
+		_sap_write_quoted(write, data, error->text);
+		break;
+	}
+	_sap_write_string(write, data, "\n");
+}
+
+// whether c is part of a word of help, a letter, digit or byte of a UTF-8
+// sequence
+/** @private */
+int _sap_word_char(char c)
+{
+	return (_sap_class(c) & (SAP_CHAR_ALPHA | SAP_CHAR_DIGIT | SAP_CHAR_LEAD
+		| SAP_CHAR_CONT)) != 0;
+}
+
+// gets ASCII lowercase of c
+/** @private */
+char _sap_fold(char c)
+{
+	return c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : c;
+}
+
+// compares words a and b of given lengths ignoring ASCII case, in the manner
+// of strcmp()
+/** @private */
+int _sap_word_cmp(const char *a, unsigned int alength, const char *b,
+	unsigned int blength)
+{
+	unsigned int length = alength < blength ? alength : blength;
+	for (unsigned int k = 0; k < length; k++)
+	{
+		unsigned char x = (unsigned char) _sap_fold(a[k]);
+		unsigned char y = (unsigned char) _sap_fold(b[k]);
+		if (x != y) return x < y ? -1 : 1;
+	}
+	return alength == blength ? 0 : alength < blength ? -1 : 1;
+}
+
+// compares keywords by word, then by argument
+/** @private */
+int _sap_keyword_cmp(const SapKeyword *a, const SapKeyword *b)
+{
+	int cmp = _sap_word_cmp(a->word, a->length, b->word, b->length);
+	if (cmp) return cmp;
+	return a->arg == b->arg ? 0 : a->arg < b->arg ? -1 : 1;
+}
+
+// adds keywords of text to keywords, if not NULL, returning their number
+/** @private */
+unsigned int _sap_add_words(SapKeyword *keywords, const char *text,
+	unsigned int arg)
+{
+	unsigned int count = 0;
+	while (text && *text)
+	{
+		const char *word = text;
+		while (_sap_word_char(*text)) text++;
+		if (text > word)
+		{
+			if (keywords)
+			{
+				keywords[count].word = word;
+				keywords[count].length = (unsigned int) (text - word);
+				keywords[count].arg = arg;
+			}
+			count++;
+		}
+		else text++;
+	}
+	return count;
+}
+
+// whether all of text is a single word
+/** @private */
+int _sap_single_word(const char *text)
+{
+	while (_sap_word_char(*text)) text++;
+	return *text == '\0';
+}
+
+// adds keywords of every argument to keywords, if not NULL, returning their
+// number
+/** @private */
+unsigned int _sap_add_keywords(const SapConfig *config, SapKeyword *keywords)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < config->argcount; i++)
+	{
+		const SapArgument *arg = config->arguments + i;
+		count += _sap_add_words(keywords ? keywords + count : NULL,
+			arg->longopt, i);
+
+		// whole long option too, if made of several words
+		if (arg->longopt && !_sap_single_word(arg->longopt))
+		{
+			if (keywords)
+			{
+				keywords[count].word = arg->longopt;
+				keywords[count].length = (unsigned int) SAP_STRLEN(
+					arg->longopt);
+				keywords[count].arg = i;
+			}
+			count++;
+		}
+		count += _sap_add_words(keywords ? keywords + count : NULL, arg->help,
+			i);
+	}
+	return count;
+}
+
+// moves keyword i down the heap of n keywords until both below it are before
+// it
+/** @private */
+void _sap_sift_keyword(SapKeyword *keywords, unsigned int i, unsigned int n)
+{
+	for (unsigned int c; (c = 2 * i + 1) < n; i = c)
+	{
+		if (c + 1 < n && _sap_keyword_cmp(keywords + c, keywords + c + 1) < 0)
+			c++;
+		if (_sap_keyword_cmp(keywords + i, keywords + c) >= 0) return;
+		SapKeyword swap = keywords[i];
+		keywords[i] = keywords[c];
+		keywords[c] = swap;
+	}
+}
+
+// sorts n keywords in place, by heapsort so that no other memory is needed
+/** @private */
+void _sap_sort_keywords(SapKeyword *keywords, unsigned int n)
+{
+	for (unsigned int i = n / 2; i-- > 0;) _sap_sift_keyword(keywords, i, n);
+	for (unsigned int end = n; end-- > 1;)
+	{
+		SapKeyword swap = keywords[0];
+		keywords[0] = keywords[end];
+		keywords[end] = swap;
+		_sap_sift_keyword(keywords, 0, end);
+	}
+}
+
+size_t sap_help_index_size(SapConfig config)
+{
+	unsigned int sections = config.sectioncount ? config.sectioncount : 1;
+	return sizeof(SapKeyword) * _sap_add_keywords(&config, NULL)
+		+ sizeof(unsigned int) * (config.argcount + sections + 2);
+}
+
+int sap_help_index_init(SapHelpIndex *index, SapConfig config, void *memory,
+	size_t size)
+{
+	if (size < sap_help_index_size(config)) return 1;
+	unsigned int sections = config.sectioncount ? config.sectioncount : 1;
+	index->config = config;
+
+	// split up memory, largest alignment first
+	index->keywords = (SapKeyword *) memory;
+	index->keywordcount = _sap_add_keywords(&config, index->keywords);
+	index->order = (unsigned int *) (index->keywords + index->keywordcount);
+	index->starts = index->order + config.argcount;
+
+	// keywords sorted, each pair of word and argument once
+	_sap_sort_keywords(index->keywords, index->keywordcount);
+	unsigned int kept = 0;
+	for (unsigned int k = 0; k < index->keywordcount; k++)
+		if (!kept || _sap_keyword_cmp(index->keywords + kept - 1,
+			index->keywords + k))
+			index->keywords[kept++] = index->keywords[k];
+	index->keywordcount = kept;
+
+	// arguments counted by section, then placed in order, positional ones
+	// counted as a section after the others
+	SAP_MEMSET(index->starts, 0, sizeof(unsigned int) * (sections + 2));
+	for (unsigned int i = 0; i < config.argcount; i++)
+	{
+		const SapArgument *arg = config.arguments + i;
+		unsigned int section = arg->type == SAP_ARG_POSITIONAL ? sections
+			: config.sectioncount ? arg->section : 0;
+		if (arg->type != SAP_ARG_POSITIONAL && section >= sections) return 1;
+		index->starts[section + 1]++;
+	}
+	for (unsigned int s = 0; s <= sections; s++)
+		index->starts[s + 1] += index->starts[s];
+	for (unsigned int i = 0; i < config.argcount; i++)
+	{
+		const SapArgument *arg = config.arguments + i;
+		unsigned int section = arg->type == SAP_ARG_POSITIONAL ? sections
+			: config.sectioncount ? arg->section : 0;
+		index->order[index->starts[section]++] = i;
+	}
+	for (unsigned int s = sections + 1; s > 0; s--)
+		index->starts[s] = index->starts[s - 1];
+	index->starts[0] = 0;
+	return 0;
+}
+
+int sap_write_help_section(const SapHelpIndex *index, const char *section,
+	SapWriteCallback write, void *data)
+{
+	const SapConfig *config = &index->config;
+	for (unsigned int s = 0; s < config->sectioncount; s++)
+	{
+		if (SAP_STRCMP(config->sections[s], section)) continue;
+		_sap_write_string(write, data, config->sections[s]);
+		_sap_write_string(write, data, ":\n");
+		for (unsigned int k = index->starts[s]; k < index->starts[s + 1]; k++)
+			_sap_write_entry(write, data, config->arguments + index->order[k]);
+		return 0;
+	}
+	return 1;
+}
+
+unsigned int sap_write_help_keyword(const SapHelpIndex *index,
+	const char *keyword, SapWriteCallback write, void *data)
+{
+	while (*keyword == '-') keyword++;
+	unsigned int length = (unsigned int) SAP_STRLEN(keyword);
+
+	// first keyword not before the one looked for
+	const SapKeyword *keywords = index->keywords;
+	unsigned int low = 0, high = index->keywordcount;
+	while (low < high)
+	{
+		unsigned int mid = low + (high - low) / 2;
+		if (_sap_word_cmp(keywords[mid].word, keywords[mid].length, keyword,
+			length) < 0)
+			low = mid + 1;
+		else high = mid;
+	}
+
+	unsigned int written = 0;
+	for (; low < index->keywordcount && !_sap_word_cmp(keywords[low].word,
+		keywords[low].length, keyword, length); low++, written++)
+		_sap_write_entry(write, data,
+			index->config.arguments + keywords[low].arg);
+	return written;
+}
+
+#ifndef SAP_FREESTANDING
+// writes help or error message to stdio stream data
+/** @private */
+void _sap_write_stream(const char *text, size_t size, void *data)
+{
+	fwrite(text, 1, size, (FILE *) data);
+}
 
 void sap_print_help(SapConfig config)
 {
-	// prints metadata
-	printf("%s %d.%d.%d\n", config.name, config.version_major,
-		config.version_minor, config.version_patch);
-	printf("%s\n%s\n\n", config.author, config.about);
+	sap_write_help(config, _sap_write_stream, stdout);
+}
+
+void sap_print_error(SapConfig config, const SapError *error)
+{
+	sap_write_error(config, error, _sap_write_stream, stderr);
+}
+
+int sap_print_help_section(const SapHelpIndex *index, const char *section)
+{
+	return sap_write_help_section(index, section, _sap_write_stream, stdout);
+}
+
+unsigned int sap_print_help_keyword(const SapHelpIndex *index,
+	const char *keyword)
+{
+	return sap_write_help_keyword(index, keyword, _sap_write_stream, stdout);
+}
+#endif
+
+const char *sap_get_value(const SapArgument *arg)
+{
+	return arg->set ? arg->value : arg->default_value;
+}
+
+#ifdef SAP_FREESTANDING
+// gets value of digit in any base up to 36, 36 if not a digit
+/** @private */
+unsigned int _sap_digit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+	return 36;
+}
+
+int sap_get_long(const SapArgument *arg, long *out)
+{
+	const char *s = sap_get_value(arg);
+	if (!s || !*s) return 1;
+
+	// as strtol() with base 0, failing on values out of range
+	while (*s == ' ' || (*s >= '\t' && *s <= '\r')) s++;
+	int negative = *s == '-';
+	if (*s == '-' || *s == '+') s++;
+	unsigned int base = 10;
+	if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X') && _sap_digit(s[2]) < 16)
+	{
+		base = 16;
+		s += 2;
+	}
+	else if (s[0] == '0') base = 8;
+
+	unsigned long limit = (~0UL >> 1) + negative; // LONG_MAX or -LONG_MIN
+	unsigned long n = 0;
+	unsigned int d;
+	const char *start = s;
+	for (; (d = _sap_digit(*s)) < base; s++)
+	{
+		if (n > (limit - d) / base) return 1;
+		n = n * base + d;
+	}
+	if (s == start) return 1;
+
+	*out = negative && n ? -(long) (n - 1) - 1 : (long) n;
+	return *s != '\0';
+}
+#else
+int sap_get_long(const SapArgument *arg, long *out)
+{
+	const char *value = sap_get_value(arg);
+	if (!value || !*value) return 1;
+
+	char *end;
+	errno = 0;
+	*out = strtol(value, &end, 0);
+	return *end != '\0' || errno == ERANGE;
+}
+
+int sap_get_double(const SapArgument *arg, double *out)
+{
+	const char *value = sap_get_value(arg);
+	if (!value || !*value) return 1;
+
+	char *end;
+	errno = 0;
+	*out = strtod(value, &end);
+	return *end != '\0' || errno == ERANGE;
+}
+#endif
+
+int sap_get_choice(const SapArgument *arg)
+{
+	if (arg->type != SAP_ARG_OPTION_VALUE || !arg->choicecount) return -1;
+	if (arg->set) return arg->choice;
+	if (!arg->default_value) return -1;
+	for (unsigned int c = 0; c < arg->choicecount; c++)
+		if (SAP_STRCMP(arg->choices[c], arg->default_value) == 0) return c;
+	return -1;
+}
+
+unsigned int sap_complete_choices(const SapArgument *arg, const char *prefix,
+	const char **out, unsigned int max)
+{
+	size_t length = SAP_STRLEN(prefix);
+	unsigned int found = 0;
+	for (unsigned int c = 0; c < arg->choicecount; c++)
+		if (SAP_STRNCMP(arg->choices[c], prefix, length) == 0)
+		{
+			if (found < max) out[found] = arg->choices[c];
+			found++;
+		}
+	return found;
+}
+
+size_t sap_incr_size(SapConfig config, unsigned int capacity)
+{
+	unsigned int posargcount = 0;
+	for (unsigned int i = 0; i < config.argcount; i++)
+		if (config.arguments[i].type == SAP_ARG_POSITIONAL) posargcount++;
+
+	unsigned int words = SAP_WORDS(config.argcount);
+	return sizeof(SapIncrToken) * capacity
+		+ sizeof(SapIncrArg) * config.argcount
+		+ sizeof(SapIncrPositional) * posargcount
+		+ sizeof(SapWord) * words * (config.rulecount + 2)
+		+ sizeof(unsigned int) * posargcount;
+}
+
+int sap_incr_init(SapIncremental *state, SapConfig config, void *memory,
+	size_t size, unsigned int capacity)
+{
+	if (size < sap_incr_size(config, capacity)) return 1;
+
+	state->config = config;
+	state->count = 0;
+	state->capacity = capacity;
+	state->posargcount = 0;
+	state->poscount = 0;
+	state->errors = 0;
+	state->missing = 0;
+	state->end = 0;
+
+	// find positional arguments and required arguments, all unset for now
+	for (unsigned int i = 0; i < config.argcount; i++)
+	{
+		SapArgument *arg = config.arguments + i;
+		arg->set = 0;
+		arg->count = 0;
+		if (config.setbits) // changed from here on without marking it
+			_sap_bit_set(config.setbits, i, 1);
+		if (arg->type == SAP_ARG_POSITIONAL) state->posargcount++;
+		if (arg->required || arg->type == SAP_ARG_POSITIONAL)
+			state->missing++;
+	}
+
+	// split up memory, largest alignment first
+	char *p = (char *) memory;
+	state->tokens = (SapIncrToken *) p;
+	p += sizeof(SapIncrToken) * capacity;
+	state->args = (SapIncrArg *) p;
+	p += sizeof(SapIncrArg) * config.argcount;
+	state->positionals = (SapIncrPositional *) p;
+	p += sizeof(SapIncrPositional) * state->posargcount;
+	state->masks = (SapWord *) p;
+	p += sizeof(SapWord) * SAP_WORDS(config.argcount) * (config.rulecount + 1);
+	state->set = (SapWord *) p;
+	p += sizeof(SapWord) * SAP_WORDS(config.argcount);
+	state->posargs = (unsigned int *) p;
+
+	SAP_MEMSET(state->set, 0, sizeof(SapWord) * SAP_WORDS(config.argcount));
+	if (_sap_build_masks(&config, state->masks)) return 1;
+
+	unsigned int k = 0;
+	for (unsigned int i = 0; i < config.argcount; i++)
+	{
+		state->args[i].count = 0;
+		state->args[i].values = 0;
+		state->args[i].holder = 0;
+		if (config.arguments[i].type == SAP_ARG_POSITIONAL)
+			state->posargs[k++] = i;
+	}
+
+	return 0;
+}
+
+// finds position of token with given label
+/** @private */
+unsigned int _sap_incr_find(const SapIncremental *state,
+	unsigned long long label)
+{
+	unsigned int lo = 0, hi = state->count;
+	while (hi - lo > 1)
+	{
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (state->tokens[mid].label <= label) lo = mid;
+		else hi = mid;
+	}
+	return lo;
+}
+
+// gets value of token as value of its argument, attached after '=' to a
+// long option or the token itself
+/** @private */
+const char *_sap_incr_text(const SapIncrToken *token)
+{
+	if (token->kind != ARG_LONGOPT) return token->text;
+	SapScan scan = _sap_scan(token->text + 2, (size_t) -1);
+	return scan.equals < scan.length ? token->text + 3 + scan.equals : NULL;
+}
+
+// checks whether token gives a value to argument i
+/** @private */
+int _sap_incr_holds(const SapIncrToken *token, int i)
+{
+	return i >= 0 && token->arg == i && (token->role == SAP_ROLE_VALUE
+		|| (token->role == SAP_ROLE_OPTION && token->kind == ARG_LONGOPT
+			&& _sap_incr_text(token)));
+}
+
+// gives every token a fresh evenly spaced label, keeping references to them
+/** @private */
+void _sap_incr_relabel(SapIncremental *state)
+{
+	unsigned int slot = 0;
+	for (unsigned int i = 0; i < state->count; i++)
+	{
+		SapIncrToken *token = state->tokens + i;
+		unsigned long long label = (i + 1) * SAP_INCR_LABEL_STEP;
+
+		// labels are unique among tokens with a role, so these match exactly
+		// the references to this token
+		if (_sap_incr_holds(token, token->arg)
+			&& state->args[token->arg].holder == token->label)
+			state->args[token->arg].holder = label;
+		else if (token->role == SAP_ROLE_POSITIONAL
+			&& slot < state->posargcount
+			&& state->positionals[slot].label == token->label)
+			state->positionals[slot++].label = label;
+
+		token->label = label;
+	}
+}
+
+// labels newly inserted token i between its neighbours
+/** @private */
+void _sap_incr_label(SapIncremental *state, unsigned int i)
+{
+	unsigned long long lo = i > 0 ? state->tokens[i - 1].label : 0;
+
+	// appending, leave a full step for following appends
+	if (i == state->count - 1)
+	{
+		if (lo < ~0ULL - SAP_INCR_LABEL_STEP)
+		{
+			state->tokens[i].label = lo + SAP_INCR_LABEL_STEP;
+			return;
+		}
+	}
+	// inserting, take the middle of the gap
+	else
+	{
+		unsigned long long hi = state->tokens[i + 1].label;
+		if (hi - lo >= 2)
+		{
+			state->tokens[i].label = lo + (hi - lo) / 2;
+			return;
+		}
+	}
+
+	// no space left between neighbours
+	_sap_incr_relabel(state);
+}
+
+// adds delta to number of times option i has been given
+/** @private */
+void _sap_incr_count(SapIncremental *state, int i, int delta)
+{
+	if (i < 0) return; // not an option of ours
+
+	SapArgument *arg = state->config.arguments + i;
+	state->args[i].count += delta;
+	arg->count = state->args[i].count;
+	int set = state->args[i].count > 0;
+	if (arg->set != set)
+	{
+		arg->set = set;
+		_sap_bit_set(state->set, i, set);
+		if (arg->required)
+		{
+			if (set) state->missing--;
+			else state->missing++;
+		}
+	}
+}
+
+// writes positional token in slot k into its argument
+/** @private */
+void _sap_incr_fill(SapIncremental *state, unsigned int k)
+{
+	SapArgument *arg = state->config.arguments + state->posargs[k];
+	if (!arg->set)
+	{
+		arg->set = 1;
+		arg->count = 1;
+		_sap_bit_set(state->set, state->posargs[k], 1);
+		state->missing--;
+	}
+	arg->value = state->positionals[k].text;
+}
+
+// adds positional token, renumbering only the positionals after it
+/** @private */
+void _sap_incr_add_positional(SapIncremental *state, SapIncrToken *token)
+{
+	unsigned int filled = state->poscount < state->posargcount
+		? state->poscount : state->posargcount;
+	state->poscount++;
+
+	// find its rank among the tokens in use
+	unsigned int r = 0;
+	while (r < filled && state->positionals[r].label < token->label) r++;
+	if (r == state->posargcount) return; // an extra positional, ignored
+
+	// shift later tokens along, dropping the last if full
+	if (filled == state->posargcount) filled--;
+	for (unsigned int k = filled; k > r; k--)
+		state->positionals[k] = state->positionals[k - 1];
+	state->positionals[r].label = token->label;
+	state->positionals[r].text = token->text;
+
+	for (unsigned int k = r; k <= filled; k++) _sap_incr_fill(state, k);
+}
+
+// removes positional token, renumbering only the positionals after it
+/** @private */
+void _sap_incr_remove_positional(SapIncremental *state, SapIncrToken *token)
+{
+	unsigned int filled = state->poscount < state->posargcount
+		? state->poscount : state->posargcount;
+	state->poscount--;
+
+	// find its slot, if any
+	unsigned int r = 0;
+	while (r < filled && state->positionals[r].label != token->label) r++;
+	if (r == filled) return; // an extra positional, ignored
+
+	// shift later tokens back
+	for (unsigned int k = r; k + 1 < filled; k++)
+		state->positionals[k] = state->positionals[k + 1];
+
+	// pull in the next positional token if there is one, otherwise the last
+	// positional argument is no longer set
+	if (state->poscount >= filled)
+	{
+		unsigned int j = filled >= 2
+			? _sap_incr_find(state, state->positionals[filled - 2].label) + 1
+			: 0;
+		while (state->tokens[j].role != SAP_ROLE_POSITIONAL) j++;
+		state->positionals[filled - 1].label = state->tokens[j].label;
+		state->positionals[filled - 1].text = state->tokens[j].text;
+	}
+	else
+	{
+		filled--;
+		state->config.arguments[state->posargs[filled]].set = 0;
+		state->config.arguments[state->posargs[filled]].count = 0;
+		_sap_bit_set(state->set, state->posargs[filled], 0);
+		state->missing++;
+	}
+
+	for (unsigned int k = r; k < filled; k++) _sap_incr_fill(state, k);
+}
+
+// adds or removes value token, or long option with its value attached,
+// keeping the last value of its argument
+/** @private */
+void _sap_incr_value(SapIncremental *state, SapIncrToken *token, int delta)
+{
+	SapIncrArg *arg = state->args + token->arg;
+	if (delta > 0)
+	{
+		if (arg->values++ == 0 || token->label > arg->holder)
+		{
+			arg->holder = token->label;
+			_sap_set_value(&state->config, token->arg, _sap_incr_text(token));
+		}
+	}
+	else if (--arg->values > 0 && arg->holder == token->label)
+	{
+		// fall back to the value before it, only for repeated options
+		unsigned int j = _sap_incr_find(state, token->label);
+		do j--;
+		while (!_sap_incr_holds(state->tokens + j, token->arg));
+		arg->holder = state->tokens[j].label;
+		_sap_set_value(&state->config, token->arg,
+			_sap_incr_text(state->tokens + j));
+	}
+}
+
+// works out the role of token i, which depends only on its neighbours
+/** @private */
+void _sap_incr_role(SapIncremental *state, unsigned int i)
+{
+	SapIncrToken *token = state->tokens + i;
+	SapArgument *args = state->config.arguments;
+	unsigned int k, n, shortopt;
+	const char *value;
+	token->role = SAP_ROLE_OPTION;
+	token->arg = -1;
+
+	// after the end of options, whatever it looks like
+	if (i > state->end)
+	{
+		token->role = SAP_ROLE_POSITIONAL;
+		return;
+	}
+
+	switch (token->kind)
+	{
+	case ARG_SHORTOPT: // short options, only valued option is remembered
+		for (k = 1; (n = _sap_next_short(token->text + k, &shortopt)); k += n)
+		{
+			int j = _sap_find_short(&state->config, shortopt);
+			if (j < 0 && (state->config.flags & SAP_FLAG_STRICT))
+			{
+				token->role = SAP_ROLE_ERROR;
+				return;
+			}
+			if (j >= 0 && args[j].type == SAP_ARG_OPTION_VALUE)
+			{
+				token->arg = j;
+				break;
+			}
+		}
+
+		// too many options set for valued option
+		if (token->arg >= 0 && (k > 1 || token->text[k + n] != '\0'))
+		{
+			token->role = SAP_ROLE_ERROR;
+			return;
+		}
+		break;
+	case ARG_LONGOPT: // long option, with its value if attached after '='
+		token->arg = _sap_find_long(&state->config, token->text + 2,
+			(size_t) -1, &value);
+		if (token->arg < 0 && (state->config.flags & SAP_FLAG_STRICT))
+		{
+			token->role = SAP_ROLE_ERROR;
+			return;
+		}
+		if (value && token->arg >= 0)
+		{
+			// attached to an option taking none, or not one of the choices
+			if (args[token->arg].type != SAP_ARG_OPTION_VALUE
+				|| (args[token->arg].choicecount
+					&& _sap_find_choice(&state->config, token->arg, value)
+						< 0))
+				token->role = SAP_ROLE_ERROR;
+			return;
+		}
+		break;
+	case ARG_NORMAL: // value of previous valued option, or positional
+		if (i > 0 && state->tokens[i - 1].role == SAP_ROLE_OPTION
+			&& state->tokens[i - 1].arg >= 0
+			&& args[state->tokens[i - 1].arg].type == SAP_ARG_OPTION_VALUE
+			&& !_sap_incr_holds(state->tokens + i - 1,
+				state->tokens[i - 1].arg))
+		{
+			// a value that is not one of the choices is an error
+			token->arg = state->tokens[i - 1].arg;
+			token->role = args[token->arg].choicecount
+				&& _sap_find_choice(&state->config, token->arg,
+					token->text) < 0 ? SAP_ROLE_ERROR : SAP_ROLE_VALUE;
+		}
+		else token->role = SAP_ROLE_POSITIONAL;
+		return;
+	case ARG_ERROR: // error
+		token->role = SAP_ROLE_ERROR;
+		return;
+	case ARG_END: // end of options
+		token->role = SAP_ROLE_END;
+		return;
+	}
+
+	// no value given
+	if (token->arg >= 0 && args[token->arg].type == SAP_ARG_OPTION_VALUE
+		&& (i + 1 == state->count || state->tokens[i + 1].kind != ARG_NORMAL))
+		token->role = SAP_ROLE_ERROR;
+}
+
+// applies (delta 1) or retracts (delta -1) the effect of token i
+/** @private */
+void _sap_incr_apply(SapIncremental *state, unsigned int i, int delta)
+{
+	SapIncrToken *token = state->tokens + i;
+	unsigned int k, n, shortopt;
+	if (delta > 0) _sap_incr_role(state, i);
+
+	// retracted tokens lose their role first, so that searches skip them
+	int role = token->role, holds = _sap_incr_holds(token, token->arg);
+	if (delta < 0) token->role = SAP_ROLE_NONE;
+
+	switch (role)
+	{
+	case SAP_ROLE_OPTION:
+		if (token->kind == ARG_LONGOPT)
+		{
+			_sap_incr_count(state, token->arg, delta);
+			if (holds) _sap_incr_value(state, token, delta);
+		}
+		else
+			for (k = 1; (n = _sap_next_short(token->text + k, &shortopt));
+				k += n)
+				_sap_incr_count(state,
+					_sap_find_short(&state->config, shortopt), delta);
+		break;
+	case SAP_ROLE_VALUE:
+		_sap_incr_value(state, token, delta);
+		break;
+	case SAP_ROLE_POSITIONAL:
+		if (delta > 0) _sap_incr_add_positional(state, token);
+		else _sap_incr_remove_positional(state, token);
+		break;
+	case SAP_ROLE_ERROR:
+		state->errors += delta;
+		break;
+	}
+}
+
+// checks whether token, not after the end of options, ends them
+/** @private */
+int _sap_incr_ends(const SapIncremental *state, const SapIncrToken *token)
+{
+	return token->role == SAP_ROLE_END
+		|| ((state->config.flags & SAP_FLAG_STOP)
+			&& token->role == SAP_ROLE_POSITIONAL);
+}
+
+// applies or retracts tokens from up to but not including to, moving the end
+// of options if they change where it is
+/** @private */
+void _sap_incr_window(SapIncremental *state, unsigned int from,
+	unsigned int to, int delta)
+{
+	unsigned int j;
+	if (to > state->count) to = state->count;
+	for (unsigned int i = from; i < to; i++)
+	{
+		_sap_incr_apply(state, i, delta);
+
+		// options now end earlier, tokens up to the old end join the tail
+		if (delta > 0 && i < state->end
+			&& _sap_incr_ends(state, state->tokens + i))
+		{
+			unsigned int end = state->end < state->count
+				? state->end : state->count - 1;
+			for (j = to; j <= end; j++) _sap_incr_apply(state, j, -1);
+			state->end = i;
+			for (j = to; j <= end; j++) _sap_incr_apply(state, j, 1);
+		}
+	}
+
+	// options now end later, parse the tail until they end again
+	if (delta > 0 && state->end < state->count
+		&& !_sap_incr_ends(state, state->tokens + state->end))
+	{
+		j = state->end + 1;
+		state->end = state->count;
+		for (; j < state->count; j++)
+		{
+			_sap_incr_apply(state, j, -1);
+			_sap_incr_apply(state, j, 1);
+			if (_sap_incr_ends(state, state->tokens + j))
+			{
+				state->end = j;
+				break;
+			}
+		}
+	}
+}
+
+int sap_incr_insert(SapIncremental *state, unsigned int index,
+	const char *token)
+{
+	if (index > state->count || state->count == state->capacity) return 1;
+
+	// only the neighbours of an edit can change role
+	unsigned int from = index > 0 ? index - 1 : 0;
+	_sap_incr_window(state, from, index + 1, -1);
+
+	SAP_MEMMOVE(state->tokens + index + 1, state->tokens + index,
+		sizeof(SapIncrToken) * (state->count - index));
+	state->count++;
+	if (state->end >= index) state->end++;
+	state->tokens[index].text = token;
+	state->tokens[index].kind = _sap_check_arg_type(token,
+		state->config.flags);
+	state->tokens[index].role = SAP_ROLE_NONE;
+	_sap_incr_label(state, index);
+
+	_sap_incr_window(state, from, index + 2, 1);
+	return 0;
+}
+
+int sap_incr_remove(SapIncremental *state, unsigned int index)
+{
+	if (index >= state->count) return 1;
+
+	unsigned int from = index > 0 ? index - 1 : 0;
+	_sap_incr_window(state, from, index + 2, -1);
+
+	SAP_MEMMOVE(state->tokens + index, state->tokens + index + 1,
+		sizeof(SapIncrToken) * (state->count - index - 1));
+	state->count--;
+	if (state->end > index) state->end--;
+
+	_sap_incr_window(state, from, index + 1, 1);
+	return 0;
+}
+
+int sap_incr_replace(SapIncremental *state, unsigned int index,
+	const char *token)
+{
+	if (index >= state->count) return 1;
+
+	unsigned int from = index > 0 ? index - 1 : 0;
+	_sap_incr_window(state, from, index + 2, -1);
+
+	state->tokens[index].text = token;
+	state->tokens[index].kind = _sap_check_arg_type(token,
+		state->config.flags);
+
+	_sap_incr_window(state, from, index + 2, 1);
+	return 0;
+}
+
+int sap_incr_status(const SapIncremental *state)
+{
+	return state->errors > 0 || state->missing > 0
+		|| _sap_check_rules(&state->config, state->masks, state->set,
+			SAP_WORDS(state->config.argcount), NULL);
+}
+
+#ifndef SAP_FREESTANDING
+// makes room for one more argument, doubling whatever is full
+/** @private */
+int _sap_registry_grow(SapRegistry *registry)
+{
+	SapCompiled *compiled = registry->config.compiled;
+	unsigned int count = registry->config.argcount + 1;
+	if (count > registry->capacity)
+	{
+		unsigned int capacity = registry->capacity
+			? registry->capacity * 2 : SAP_REGISTRY_ARGS;
+		SapArgument *arguments = (SapArgument *) realloc(
+			registry->config.arguments, sizeof(SapArgument) * capacity);
+		if (!arguments) return 1;
+		registry->config.arguments = arguments;
+
+		// arrays by argument in one block, largest alignment first, the
+		// required mask and setbits zeroed beyond the arguments so far
+		unsigned int words = SAP_WORDS(capacity);
+		SapWord *masks = (SapWord *) calloc(1, sizeof(SapWord) * 2 * words
+			+ (sizeof(unsigned int) * 4 + 1) * capacity);
+		if (!masks) return 1;
+		SapWord *setbits = masks + words;
+		unsigned int *shortopts = (unsigned int *) (setbits + words);
+		unsigned int *hashes = shortopts + capacity;
+		unsigned int *lengths = hashes + capacity;
+		unsigned int *choiceoffsets = lengths + capacity;
+		unsigned char *types = (unsigned char *) (choiceoffsets + capacity);
+		unsigned int n = registry->config.argcount;
+		if (registry->capacity)
+		{
+			SAP_MEMCPY(masks, compiled->masks, sizeof(SapWord) * SAP_WORDS(n));
+			SAP_MEMCPY(setbits, registry->config.setbits,
+				sizeof(SapWord) * SAP_WORDS(n));
+			SAP_MEMCPY(shortopts, compiled->shortopts,
+				sizeof(unsigned int) * n);
+			SAP_MEMCPY(hashes, compiled->hashes, sizeof(unsigned int) * n);
+			SAP_MEMCPY(lengths, compiled->lengths, sizeof(unsigned int) * n);
+			SAP_MEMCPY(types, compiled->types, n);
+		}
+		free(compiled->masks);
+		compiled->masks = masks;
+		compiled->shortopts = shortopts;
+		compiled->hashes = hashes;
+		compiled->lengths = lengths;
+		compiled->choiceoffsets = choiceoffsets; // choices searched in order
+		compiled->types = types;
+		registry->config.setbits = setbits;
+		registry->capacity = capacity;
+	}
+
+	// keep tables at most half full
+	unsigned int size = compiled->tablemask + 1;
+	if (compiled->longtable && 2 * count <= size) return 0;
+	size = compiled->longtable ? size * 2 : SAP_REGISTRY_TABLE;
+	unsigned int *tables = (unsigned int *) calloc(2 * size + SAP_SHORT_TABLE,
+		sizeof(unsigned int));
+	if (!tables) return 1;
+	free(compiled->longtable);
+	compiled->longtable = tables;
+	compiled->widetable = tables + size;
+	compiled->shorttable = tables + 2 * size;
+	compiled->tablemask = size - 1;
+	for (unsigned int i = 0; i < registry->config.argcount; i++)
+		_sap_compile_index(compiled, registry->config.arguments + i, i);
+	return 0;
+}
+
+// allocates size bytes in chunks to copy strings into, NULL if out of memory
+/** @private */
+char *_sap_registry_alloc(SapRegistry *registry, size_t size)
+{
+	// allocations are aligned for an array of choices
+	SapRegistryChunk *chunk = registry->chunks;
+	size_t used = chunk ? (chunk->used + sizeof(void *) - 1)
+		/ sizeof(void *) * sizeof(void *) : 0;
+	if (!chunk || chunk->size < used + size)
+	{
+		// chunks double in size, so there are O(log n) of them
+		size_t chunksize = chunk ? chunk->size * 2 : SAP_REGISTRY_CHUNK;
+		if (chunksize < size) chunksize = size;
+		chunk = (SapRegistryChunk *) malloc(sizeof(SapRegistryChunk)
+			+ chunksize);
+		if (!chunk) return NULL;
+		chunk->next = registry->chunks;
+		chunk->size = chunksize;
+		registry->chunks = chunk;
+		used = 0;
+	}
+	chunk->used = used + size;
+	return (char *) (chunk + 1) + used;
+}
+
+int sap_registry_init(SapRegistry *registry, SapConfig config)
+{
+	SAP_MEMSET(registry, 0, sizeof(SapRegistry));
+	registry->config = config;
+	registry->config.arguments = NULL;
+	registry->config.argcount = 0;
+	registry->config.rules = NULL;
+	registry->config.rulecount = 0;
 
-	// prints usage
-	printf("USAGE:\n\t%s [FLAGS] ", config.name);
+	// compiled configuration kept up to date, arrays by argument in one block
+	// from masks, tables in one from longtable
+	registry->config.compiled = (SapCompiled *) calloc(1,
+		sizeof(SapCompiled));
+	if (!registry->config.compiled || _sap_registry_grow(registry)) return 1;
 
-	// iterate through arguments to print usage
 	for (unsigned int i = 0; i < config.argcount; i++)
+		if (sap_config_add(registry, NULL, config.arguments + i) < 0)
+			return 1;
+	return 0;
+}
+
+int sap_config_add(SapRegistry *registry, const char *group,
+	const SapArgument *argument)
+{
+	size_t grouplength = group && argument->longopt ? SAP_STRLEN(group) + 1
+		: 0;
+	size_t longlength = argument->longopt ? SAP_STRLEN(argument->longopt) + 1
+		: 0;
+	size_t helplength = argument->help ? SAP_STRLEN(argument->help) + 1 : 0;
+	size_t defaultlength = argument->default_value
+		? SAP_STRLEN(argument->default_value) + 1 : 0;
+	if (_sap_registry_grow(registry)) return -1;
+
+	// copy strings, longopt first so that a taken one can be given back
+	char *p = _sap_registry_alloc(registry,
+		grouplength + longlength + helplength + defaultlength);
+	if (!p) return -1;
+	char *longopt = argument->longopt ? p : NULL;
+	if (grouplength)
 	{
-		SapArgument arg = config.arguments[i];
-		if (arg.type == SAP_ARG_POSITIONAL)
+		SAP_MEMCPY(p, group, grouplength - 1);
+		p[grouplength - 1] = '.';
+	}
+	if (longopt) SAP_MEMCPY(p + grouplength, argument->longopt, longlength);
+
+	unsigned int i = registry->config.argcount;
+	int taken = (longopt && _sap_find_name(&registry->config, longopt,
+			grouplength + longlength - 1, 1) >= 0)
+		|| (argument->type != SAP_ARG_POSITIONAL && _sap_shortopt(argument)
+			&& _sap_find_short(&registry->config, _sap_shortopt(argument))
+				>= 0);
+
+	// copy choices, the array first so that it is aligned
+	const char **choices = NULL;
+	if (!taken && argument->choicecount)
+	{
+		size_t choicesize = sizeof(const char *) * argument->choicecount;
+		for (unsigned int c = 0; c < argument->choicecount; c++)
+			choicesize += SAP_STRLEN(argument->choices[c]) + 1;
+		choices = (const char **) _sap_registry_alloc(registry, choicesize);
+		if (choices)
 		{
-			if (arg.required)
+			char *q = (char *) (choices + argument->choicecount);
+			for (unsigned int c = 0; c < argument->choicecount; c++)
 			{
-				printf("%s ", arg.longopt);
+				size_t length = SAP_STRLEN(argument->choices[c]) + 1;
+				choices[c] = (const char *) SAP_MEMCPY(q,
+					argument->choices[c], length);
+				q += length;
 			}
-			else
+		}
+	}
+	if (taken || (argument->choicecount && !choices))
+	{
+		registry->chunks->used = p - (char *) (registry->chunks + 1);
+		return -1;
+	}
+
+	SapArgument *arg = registry->config.arguments + i;
+	*arg = *argument;
+	arg->longopt = longopt;
+	arg->choices = choices;
+	p += grouplength + longlength;
+	if (argument->help)
+	{
+		arg->help = (const char *) SAP_MEMCPY(p, argument->help, helplength);
+		p += helplength;
+	}
+	if (argument->default_value)
+		arg->default_value = (const char *) SAP_MEMCPY(p,
+			argument->default_value, defaultlength);
+
+	SapCompiled *compiled = registry->config.compiled;
+	_sap_compile_index(compiled, arg, i);
+	if (arg->required || arg->type == SAP_ARG_POSITIONAL)
+		_sap_bit_set(compiled->masks, i, 1);
+	if (arg->set) _sap_bit_set(registry->config.setbits, i, 1);
+	registry->config.argcount++;
+	compiled->words = SAP_WORDS(registry->config.argcount);
+	return i;
+}
+
+int sap_registry_find(const SapRegistry *registry, const char *longopt)
+{
+	return _sap_find_name(&registry->config, longopt, SAP_STRLEN(longopt), 1);
+}
+
+void sap_registry_free(SapRegistry *registry)
+{
+	while (registry->chunks)
+	{
+		SapRegistryChunk *next = registry->chunks->next;
+		free(registry->chunks);
+		registry->chunks = next;
+	}
+	free(registry->config.arguments);
+	if (registry->config.compiled)
+	{
+		free(registry->config.compiled->masks);
+		free(registry->config.compiled->longtable);
+		free(registry->config.compiled);
+	}
+	SAP_MEMSET(registry, 0, sizeof(SapRegistry));
+}
+#endif
+
+#if defined(__linux__) && !defined(SAP_FREESTANDING)
+// opens file for reading, closed in programs the process runs
+/** @private */
+int _sap_open(const char *path)
+{
+#ifdef O_CLOEXEC
+	return open(path, O_RDONLY | O_CLOEXEC);
+#else
+	// hidden without POSIX.1-2008 feature macros, as with -std=c99
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+#endif
+}
+
+int sap_proc_sweep(SapConfig config, char *buffer, size_t size,
+	SapProcCallback callback, void *data)
+{
+	if (size < 2) return 1;
+	DIR *proc = opendir("/proc");
+	if (!proc) return 1;
+
+	struct dirent *entry;
+	while ((entry = readdir(proc)))
+	{
+		// only directories named by a process ID
+		const char *c = entry->d_name;
+		int pid = 0;
+		for (; _sap_class(*c) & SAP_CHAR_DIGIT && c - entry->d_name < 10; c++)
+			pid = pid * 10 + (*c - '0');
+		if (*c != '\0' || c == entry->d_name) continue;
+
+		// /proc/<pid>/cmdline, built without stdio
+		char path[32] = "/proc/";
+		SAP_MEMCPY(path + 6, entry->d_name, c - entry->d_name);
+		SAP_MEMCPY(path + 6 + (c - entry->d_name), "/cmdline", 9);
+		int fd = _sap_open(path);
+		if (fd < 0) continue; // gone already
+
+		size_t length = 0;
+		ssize_t n;
+		while (length < size - 1
+			&& (n = read(fd, buffer + length, size - 1 - length)) > 0)
+			length += n;
+		close(fd);
+		if (length == 0) continue; // kernel thread or zombie
+		if (buffer[length - 1] != '\0') buffer[length++] = '\0'; // cut short
+
+		SapResult result;
+		int status = sap_parse_buffer(config, buffer, length, &result);
+		if (callback(pid, status, &result, buffer, length, data)) break;
+	}
+
+	closedir(proc);
+	return 0;
+}
+
+// reads file of reloader into slot as NUL-separated tokens after the name
+/** @private */
+int _sap_reload_read(SapReloader *reloader, SapSnapshot *slot, size_t *size)
+{
+	const char *name = reloader->config.name ? reloader->config.name : "";
+	size_t start = SAP_STRLEN(name) + 1, length = start;
+	int fd = _sap_open(reloader->path);
+	if (fd < 0) return 1;
+
+	for (;;)
+	{
+		// room for the whole file and a NUL ending the last token
+		if (slot->buffersize < length + 2)
+		{
+			size_t buffersize = slot->buffersize ? slot->buffersize * 2 : 4096;
+			char *buffer = (char *) realloc(slot->buffer, buffersize);
+			if (!buffer) break;
+			slot->buffer = buffer;
+			slot->buffersize = buffersize;
+		}
+		ssize_t n = read(fd, slot->buffer + length,
+			slot->buffersize - 1 - length);
+		if (n <= 0)
+		{
+			close(fd);
+			if (n < 0) return 1;
+			SAP_MEMCPY(slot->buffer, name, start);
+
+			// tokens are never longer than the text they come from
+			char *in = slot->buffer + start, *out = in;
+			const char *end = slot->buffer + length;
+			while (in < end)
 			{
-				printf("[%s] ", arg.longopt);
+				if (*in == ' ' || (*in >= '\t' && *in <= '\r')) in++;
+				else if (*in == '#')
+					while (in < end && *in != '\n') in++;
+				else
+				{
+					while (in < end && *in != ' '
+						&& (*in < '\t' || *in > '\r'))
+						*out++ = *in++;
+					*out++ = '\0';
+					in++;
+				}
 			}
+			*size = out - slot->buffer;
+			return 0;
 		}
+		length += n;
 	}
-	printf("\n\n");
+	close(fd);
+	return 1;
+}
 
-	// prints flags
-	printf("FLAGS:\n");
-	for (unsigned int i = 0; i < config.argcount; i++)
+// loads file of reloader into slot, parsed into its own arguments
+/** @private */
+int _sap_reload_load(SapReloader *reloader, SapSnapshot *slot)
+{
+	size_t size;
+	if (_sap_reload_read(reloader, slot, &size)) return 1;
+
+	SapConfig config = reloader->config;
+	SAP_MEMCPY(slot->args, config.arguments,
+		config.argcount * sizeof(SapArgument));
+	config.arguments = slot->args;
+	config.setbits = NULL; // marks what was set in config.arguments only
+	config.callback = NULL;
+	config.callback_data = NULL;
+	config.stream = NULL;
+	config.arena = NULL; // values point into the snapshot already
+	return sap_parse_buffer(config, slot->buffer, size, NULL);
+}
+
+// gets whether argument changed between loads
+/** @private */
+int _sap_reload_changed(const SapArgument *old, const SapArgument *now)
+{
+	if (old->set != now->set) return 1;
+	if (!now->set) return 0;
+	if (old->count != now->count) return 1;
+	if (!old->value || !now->value) return old->value != now->value;
+	return SAP_STRCMP(old->value, now->value) != 0;
+}
+
+int sap_reload_init(SapReloader *reloader, SapConfig config, const char *path,
+	SapReloadCallback callback, void *data)
+{
+	SAP_MEMSET(reloader, 0, sizeof(SapReloader));
+	reloader->fd = -1;
+	reloader->config = config;
+	reloader->path = path;
+	reloader->callback = callback;
+	reloader->data = data;
+	for (unsigned int s = 0; s < SAP_RELOAD_SLOTS; s++)
 	{
-		SapArgument arg = config.arguments[i];
-		if (arg.type != SAP_ARG_POSITIONAL)
+		reloader->slots[s].args = (SapArgument *) malloc(
+			(config.argcount ? config.argcount : 1) * sizeof(SapArgument));
+		if (!reloader->slots[s].args) return 1;
+	}
+
+	// watch the directory before loading, not to miss a change in between
+	reloader->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (reloader->fd < 0) return 1;
+	const char *slash = NULL;
+	for (const char *c = path; *c; c++)
+		if (*c == '/') slash = c;
+	const char *from = !slash ? "." : slash == path ? "/" : path;
+	size_t length = !slash || slash == path ? 1 : (size_t) (slash - path);
+	char *directory = (char *) malloc(length + 1);
+	if (!directory) return 1;
+	SAP_MEMCPY(directory, from, length);
+	directory[length] = '\0';
+	int watch = inotify_add_watch(reloader->fd, directory,
+		IN_CLOSE_WRITE | IN_MOVED_TO);
+	free(directory);
+	if (watch < 0) return 1;
+
+	SapSnapshot *slot = &reloader->slots[0];
+	if (_sap_reload_load(reloader, slot)) return 1;
+	slot->arguments = slot->args;
+	slot->argcount = config.argcount;
+	slot->generation = 1;
+	__atomic_store_n(&reloader->current, 1ULL << 8, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+int sap_reload_poll(SapReloader *reloader)
+{
+	const char *name = reloader->path;
+	for (const char *c = reloader->path; *c; c++)
+		if (*c == '/') name = c + 1;
+
+	// drain events, any of them naming the file or lost in overflow counts
+	union
+	{
+		struct inotify_event event;
+		char bytes[4096];
+	} events;
+	ssize_t n;
+	while ((n = read(reloader->fd, events.bytes, sizeof(events))) > 0)
+	{
+		for (char *p = events.bytes; p < events.bytes + n;)
 		{
-			printf("\t-%c, --%s %s\n", arg.shortopt, arg.longopt, arg.help);
+			struct inotify_event *event = (struct inotify_event *) p;
+			if (event->mask & IN_Q_OVERFLOW
+				|| (event->len && SAP_STRCMP(event->name, name) == 0))
+				reloader->pending = 1;
+			p += sizeof(struct inotify_event) + event->len;
 		}
 	}
-	printf("\n");
+	if (!reloader->pending) return 0;
+
+	// a spare slot no reader holds, none can take it as it is not current
+	unsigned long long current = __atomic_load_n(&reloader->current,
+		__ATOMIC_SEQ_CST);
+	unsigned int old = current & 0xff, s = old;
+	do
+		s = (s + 1) % SAP_RELOAD_SLOTS;
+	while (s != old && __atomic_load_n(&reloader->slots[s].readers,
+		__ATOMIC_SEQ_CST) != 0);
+	if (s == old) return 1;
+
+	SapSnapshot *slot = &reloader->slots[s];
+	reloader->pending = 0;
+	if (_sap_reload_load(reloader, slot)) return 1;
+	slot->arguments = slot->args;
+	slot->argcount = reloader->config.argcount;
+	slot->generation = (current >> 8) + 1;
+	__atomic_store_n(&reloader->current, slot->generation << 8 | s,
+		__ATOMIC_SEQ_CST);
+
+	// the previous slot is only written again by a later poll
+	if (reloader->callback)
+		for (unsigned int i = 0; i < slot->argcount; i++)
+			if (_sap_reload_changed(&reloader->slots[old].args[i],
+				&slot->args[i]))
+				reloader->callback(i, &reloader->slots[old].args[i],
+					&slot->args[i], reloader->data);
+	return 0;
+}
+
+const SapSnapshot *sap_reload_acquire(SapReloader *reloader)
+{
+	// counted in before checking it is still current, so a poll either sees
+	// the count or the check sees the swap
+	for (;;)
+	{
+		unsigned long long current = __atomic_load_n(&reloader->current,
+			__ATOMIC_SEQ_CST);
+		SapSnapshot *slot = &reloader->slots[current & 0xff];
+		__atomic_add_fetch(&slot->readers, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&reloader->current, __ATOMIC_SEQ_CST) == current)
+			return slot;
+		__atomic_sub_fetch(&slot->readers, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+void sap_reload_release(const SapSnapshot *snapshot)
+{
+	__atomic_sub_fetch(&((SapSnapshot *) snapshot)->readers, 1,
+		__ATOMIC_RELEASE);
+}
+
+void sap_reload_free(SapReloader *reloader)
+{
+	if (reloader->fd >= 0) close(reloader->fd);
+	reloader->fd = -1;
+	for (unsigned int s = 0; s < SAP_RELOAD_SLOTS; s++)
+	{
+		free(reloader->slots[s].args);
+		free(reloader->slots[s].buffer);
+		reloader->slots[s].args = NULL;
+		reloader->slots[s].buffer = NULL;
+		reloader->slots[s].buffersize = 0;
+	}
+}
+#endif
+
+size_t sap_cache_size(SapConfig config, unsigned int capacity,
+	unsigned int maxbytes)
+{
+	unsigned int maxrecords = config.argcount < maxbytes
+		? config.argcount : maxbytes;
+	return sizeof(SapCacheEntry) * capacity
+		+ sizeof(SapCacheRecord) * capacity * maxrecords
+		+ sizeof(unsigned int) * _sap_table_size(capacity)
+		+ sizeof(char) * capacity * maxbytes;
+}
+
+int sap_cache_init(SapCache *cache, SapConfig config, void *memory,
+	size_t size, unsigned int capacity, unsigned int maxbytes)
+{
+	if (capacity == 0 || size < sap_cache_size(config, capacity, maxbytes))
+		return 1;
 
-	// prints arguments
-	printf("ARGUMENTS:\n");
+	cache->config = config;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->unstored = 0;
+	cache->capacity = capacity;
+	cache->used = 0;
+	cache->bucketmask = _sap_table_size(capacity) - 1;
+	cache->maxbytes = maxbytes;
+	cache->maxrecords = config.argcount < maxbytes
+		? config.argcount : maxbytes;
+	cache->head = capacity;
+	cache->tail = capacity;
+	cache->full = config.callback || config.stream;
 	for (unsigned int i = 0; i < config.argcount; i++)
+		if (config.arguments[i].callback) cache->full = 1;
+
+	// split up memory, largest alignment first
+	char *p = (char *) memory;
+	cache->entries = (SapCacheEntry *) p;
+	p += sizeof(SapCacheEntry) * capacity;
+	cache->records = (SapCacheRecord *) p;
+	p += sizeof(SapCacheRecord) * capacity * cache->maxrecords;
+	cache->buckets = (unsigned int *) p;
+	p += sizeof(unsigned int) * (cache->bucketmask + 1);
+	cache->text = p;
+
+	for (unsigned int b = 0; b <= cache->bucketmask; b++)
+		cache->buckets[b] = capacity;
+	return 0;
+}
+
+// unlinks entry e from the least recently used list
+/** @private */
+void _sap_cache_unlink(SapCache *cache, unsigned int e)
+{
+	SapCacheEntry *entry = cache->entries + e;
+	if (entry->prev < cache->capacity)
+		cache->entries[entry->prev].next = entry->next;
+	else cache->head = entry->next;
+	if (entry->next < cache->capacity)
+		cache->entries[entry->next].prev = entry->prev;
+	else cache->tail = entry->prev;
+}
+
+// links entry e as the most recently used
+/** @private */
+void _sap_cache_push(SapCache *cache, unsigned int e)
+{
+	SapCacheEntry *entry = cache->entries + e;
+	entry->prev = cache->capacity;
+	entry->next = cache->head;
+	if (cache->head < cache->capacity) cache->entries[cache->head].prev = e;
+	else cache->tail = e;
+	cache->head = e;
+}
+
+// finds entry holding tokens of argv, capacity if none
+/** @private */
+unsigned int _sap_cache_find(const SapCache *cache, int argc, char **argv,
+	unsigned long long hash, unsigned int textsize)
+{
+	for (unsigned int e = cache->buckets[hash & cache->bucketmask];
+		e < cache->capacity; e = cache->entries[e].chain)
 	{
-		SapArgument arg = config.arguments[i];
-		if (arg.type == SAP_ARG_POSITIONAL)
+		const SapCacheEntry *entry = cache->entries + e;
+		if (entry->hash != hash || entry->argc != argc
+			|| entry->textsize != textsize) continue;
+
+		// hashes match, compare tokens to be sure
+		const char *text = cache->text + (size_t) e * cache->maxbytes;
+		int j;
+		for (j = 1; j < argc; j++)
 		{
-			printf("\t%s %s\n", arg.longopt, arg.help);
+			size_t length = SAP_STRLEN(text) + 1;
+			if (SAP_MEMCMP(text, argv[j], length) != 0) break;
+			text += length;
 		}
+		if (j == argc) return e;
+	}
+	return cache->capacity;
+}
+
+// remembers results of parsing argv, finding values by the occurrences the
+// parse streamed, forgetting the least recently used command line if full, 1
+// if they cannot be remembered
+/** @private */
+int _sap_cache_store(SapCache *cache, int argc, char **argv,
+	const SapStream *stream, const SapResult *result, unsigned long long hash,
+	unsigned int textsize)
+{
+	if (stream->count > stream->capacity) return 1;
+
+	// last occurrence of each argument, which its value is from
+	unsigned int last[cache->config.argcount + 1];
+	for (unsigned int o = 0; o < stream->count; o++)
+		last[stream->occurrences[o].arg] = o;
+
+	// records of arguments set, values found by their token
+	SapCacheRecord records[cache->maxrecords + 1];
+	unsigned int recordcount = 0;
+	for (unsigned int i = 0; i < cache->config.argcount; i++)
+	{
+		SapArgument *arg = cache->config.arguments + i;
+		if (!arg->set) continue;
+		if (recordcount == cache->maxrecords) return 1; // too many
+		SapCacheRecord *record = records + recordcount++;
+		record->arg = i;
+		record->count = arg->count;
+		record->token = -1;
+		record->offset = 0;
+		record->choice = arg->choice;
+		if (arg->type == SAP_ARG_OPTION) continue;
+
+		// in the token of the option or positional, or the one after it
+		const SapOccurrence *occurrence = stream->occurrences + last[i];
+		int j = occurrence->position;
+		if (arg->value != occurrence->value) return 1; // value from elsewhere
+		if (j + 1 < argc && arg->value == argv[j + 1]) j++;
+		record->token = j;
+		record->offset = (unsigned int) (arg->value - argv[j]);
+	}
+
+	// take a free entry, or the least recently used
+	unsigned int e;
+	if (cache->used < cache->capacity) e = cache->used++;
+	else
+	{
+		e = cache->tail;
+		_sap_cache_unlink(cache, e);
+		unsigned int *link = cache->buckets
+			+ (cache->entries[e].hash & cache->bucketmask);
+		while (*link != e) link = &cache->entries[*link].chain;
+		*link = cache->entries[e].chain;
+	}
+
+	SapCacheEntry *entry = cache->entries + e;
+	entry->hash = hash;
+	entry->argc = argc;
+	entry->tail_argc = result->tail_argc;
+	entry->textsize = textsize;
+	entry->recordcount = recordcount;
+	SAP_MEMCPY(cache->records + (size_t) e * cache->maxrecords, records,
+		sizeof(SapCacheRecord) * recordcount);
+	char *text = cache->text + (size_t) e * cache->maxbytes;
+	for (int j = 1; j < argc; j++)
+	{
+		size_t length = SAP_STRLEN(argv[j]) + 1;
+		SAP_MEMCPY(text, argv[j], length);
+		text += length;
+	}
+
+	_sap_cache_push(cache, e);
+	entry->chain = cache->buckets[hash & cache->bucketmask];
+	cache->buckets[hash & cache->bucketmask] = e;
+	return 0;
+}
+
+int sap_cache_parse(SapCache *cache, int argc, char **argv,
+	SapResult *result)
+{
+	// hash tokens, FNV-1a with the NUL after each, stopping if too long
+	unsigned long long hash = 14695981039346656037ULL;
+	size_t textsize = 0;
+	for (int j = 1; j < argc && textsize <= cache->maxbytes; j++)
+	{
+		const char *c = argv[j];
+		do hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+		while (*c++);
+		textsize += c - argv[j];
+	}
+
+	SapResult local;
+	if (!result) result = &local;
+	if (textsize > cache->maxbytes || cache->full) // not to remember
+		return sap_parse(cache->config, argc, argv, result);
+
+	unsigned int e = _sap_cache_find(cache, argc, argv, hash,
+		(unsigned int) textsize);
+	if (e == cache->capacity)
+	{
+		cache->misses++;
+
+		// every argument given streamed, each taking a byte at least, so
+		// that values are found by their token without searching argv
+		SapOccurrence occurrences[textsize + 1];
+		SapStream stream = { occurrences, (unsigned int) textsize + 1, 0 };
+		SapConfig config = cache->config;
+		config.arena = NULL; // remembered in terms of argv, copied after
+		config.stream = &stream;
+		int status = sap_parse(config, argc, argv, result);
+		if (status == 0 && _sap_cache_store(cache, argc, argv, &stream,
+			result, hash, (unsigned int) textsize))
+			cache->unstored++;
+		if (cache->config.arena && _sap_arena_copy(&cache->config, result)
+			&& !status)
+			return _sap_fail(&result->error, SAP_ERROR_MEMORY, -1, NULL, -1);
+		return status;
+	}
+
+	// hit, write remembered results in terms of this argv
+	cache->hits++;
+	_sap_cache_unlink(cache, e);
+	_sap_cache_push(cache, e);
+
+	SapConfig *config = &cache->config;
+	SapWord local_set[config->setbits ? 1 : SAP_WORDS(config->argcount) + 1];
+	SapWord *set = config->setbits ? config->setbits : local_set;
+	_sap_clear(config, set);
+
+	const SapCacheEntry *entry = cache->entries + e;
+	const SapCacheRecord *record = cache->records
+		+ (size_t) e * cache->maxrecords;
+	for (unsigned int r = 0; r < entry->recordcount; r++, record++)
+	{
+		SapArgument *arg = config->arguments + record->arg;
+		arg->set = 1;
+		arg->count = record->count;
+		if (record->token >= 0)
+			arg->value = argv[record->token] + record->offset;
+		arg->choice = record->choice;
+		_sap_bit_set(set, record->arg, 1);
 	}
+	result->tail_argc = entry->tail_argc;
+	result->tail_argv = argv + argc - entry->tail_argc;
+	result->tail_buffer = NULL;
+	result->tail_size = 0;
+	_sap_fail(&result->error, SAP_ERROR_NONE, -1, NULL, -1);
+	if (config->arena && _sap_arena_copy(config, result))
+		return _sap_fail(&result->error, SAP_ERROR_MEMORY, -1, NULL, -1);
+	return 0;
 }
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
 
 /*
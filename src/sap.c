@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2020 Chua Hou
+
+/**
+ * @file sap.c
+ * @brief Implementation of sap, compiled once into the sap library
+ */
+
+#define SAP_IMPLEMENTATION
+#include "sap.h"
@@ -7,6 +7,7 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
+#include <utility>
 
 #include "sap.h"
 
@@ -34,7 +35,7 @@
  */
 SapConfig setup_test_config()
 {
-	SapConfig config;
+	SapConfig config = {};
 	config.name = "ctests";
 	config.version_major = 1;
 	config.version_minor = 2;
@@ -42,48 +43,48 @@ SapConfig setup_test_config()
 	config.author = "Chua Hou";
 	config.about = "C language test for sap";
 
-	SapArgument helpOpt;
+	SapArgument helpOpt = {};
 	helpOpt.shortopt = 'h';
 	helpOpt.longopt = "help";
 	helpOpt.type = SAP_ARG_OPTION;
 	helpOpt.required = 0;
 	helpOpt.help = "Prints this help message";
 
-	SapArgument posOpt1;
+	SapArgument posOpt1 = {};
 	posOpt1.longopt = "POSITIONALARG1";
 	posOpt1.type = SAP_ARG_POSITIONAL;
 	posOpt1.required = 1;
 	posOpt1.help = "A positional argument";
 
-	SapArgument valueOpt1;
+	SapArgument valueOpt1 = {};
 	valueOpt1.shortopt = 'v';
 	valueOpt1.longopt = "value";
 	valueOpt1.type = SAP_ARG_OPTION_VALUE;
 	valueOpt1.required = 1;
 	valueOpt1.help = "A valued option";
 
-	SapArgument flagOpt1;
+	SapArgument flagOpt1 = {};
 	flagOpt1.shortopt = 'a';
 	flagOpt1.longopt = "aflag";
 	flagOpt1.type = SAP_ARG_OPTION;
 	flagOpt1.required = 0;
 	flagOpt1.help = "Flag A";
 
-	SapArgument valueOpt2;
+	SapArgument valueOpt2 = {};
 	valueOpt2.shortopt = 'c';
 	valueOpt2.longopt = "cvalue";
 	valueOpt2.type = SAP_ARG_OPTION_VALUE;
 	valueOpt2.required = 0;
 	valueOpt2.help = "Another valued option";
 
-	SapArgument flagOpt2;
+	SapArgument flagOpt2 = {};
 	flagOpt2.shortopt = 'b';
 	flagOpt2.longopt = "bflag";
 	flagOpt2.type = SAP_ARG_OPTION;
 	flagOpt2.required = 0;
 	flagOpt2.help = "Flag B";
 
-	SapArgument posOpt2;
+	SapArgument posOpt2 = {};
 	posOpt2.longopt = "ANOTHERPOSARG";
 	posOpt2.type = SAP_ARG_POSITIONAL;
 	posOpt2.required = 1;
@@ -125,7 +126,7 @@ void copy_argv(int argc, char **argv, ...)
 	va_end(strings);
 }
 
-#define FREE_ARGV(argc, argv) for (int i = 0; i < argc; i++) delete argv[i]
+#define FREE_ARGV(argc, argv) for (int i = 0; i < argc; i++) delete[] argv[i]
 
 /**
  * @brief Tests valued arguments with provided config
@@ -289,6 +290,223 @@ void test_nonalpha(SapConfig config)
 	FREE_ARGV(5, argv2);
 }
 
+/**
+ * @brief Test C++ views over results with specified config
+ *
+ * @param config config
+ */
+void test_views(SapConfig config)
+{
+	printf("Testing C++ views...\n");
+
+	printf("Testing lookup by key\n");
+	char *argv1[10];
+	copy_argv(10, argv1, "ctests", "posarg", "-a", "-v", "value", "--bflag",
+		"posarg2", "extra", "--value", "again");
+	assert(sap_parse_args(config, 10, argv1) == 0);
+	sap::results results(config, 10, argv1);
+	assert(results.arguments().size() == 7);
+	assert(results.argv().size() == 10);
+	assert(results.find('v') == config.arguments + 2);
+	assert(results.find("value") == config.arguments + 2);
+	assert(results.find("POSITIONALARG1") == config.arguments + 1);
+	assert(results.find('x') == nullptr);
+	assert(results.find("valu") == nullptr);
+	assert(results.is_set('a') && results.is_set("bflag"));
+	assert(!results.is_set('h') && !results.is_set("nothing"));
+	assert(results.count('v') == 2 && results.count('h') == 0);
+	assert(results.value("value") == sap::view("again"));
+	assert(results.value("ANOTHERPOSARG") == sap::view("posarg2"));
+	assert(results.value('c').empty());
+
+	printf("Testing lookup by key through compiled configuration\n");
+	SapConfig compiled = config;
+	std::size_t size = sap_compile_size(config);
+	void *memory = malloc(size);
+	assert(sap_compile(&compiled, memory, size) == 0);
+	sap::results hashed(compiled, 10, argv1);
+	assert(hashed.find('v') == config.arguments + 2);
+	assert(hashed.find("value") == config.arguments + 2);
+	assert(hashed.find("POSITIONALARG1") == config.arguments + 1);
+	assert(hashed.find("ANOTHERPOSARG") == config.arguments + 6);
+	assert(hashed.find('x') == nullptr);
+	assert(hashed.find("valu") == nullptr);
+	assert(hashed.count('v') == 2 && hashed.is_set("bflag"));
+	char *argv2[4]; // names of positional arguments are not long options
+	copy_argv(4, argv2, "ctests", "posarg", "--ANOTHERPOSARG", "posarg2");
+	int status = sap_parse_args(config, 4, argv2);
+	assert(sap_parse_args(compiled, 4, argv2) == status);
+	assert(strcmp(config.arguments[6].value, "posarg2") == 0);
+	FREE_ARGV(4, argv2);
+	free(memory);
+
+	printf("Testing occurrences in argv order\n");
+	const int expected[][2] = // argument index, position
+	{
+		{ 1, 1 }, { 3, 2 }, { 2, 3 }, { 5, 5 }, { 6, 6 }, { -1, 7 }, { 2, 8 }
+	};
+	int n = 0;
+	for (const sap::occurrence &o : results.occurrences())
+	{
+		int index = o.argument ? o.argument - config.arguments : -1;
+		assert(index == expected[n][0]);
+		assert(o.position == expected[n][1]);
+		n++;
+	}
+	assert(n == 7);
+
+	printf("Testing occurrences of one argument\n");
+	n = 0;
+	for (const sap::occurrence &o : results.occurrences("value"))
+	{
+		assert(o.argument == config.arguments + 2);
+		assert(o.value == sap::view(n == 0 ? "value" : "again"));
+		n++;
+	}
+	assert(n == 2);
+	for (const sap::occurrence &o : results.occurrences('h'))
+		assert(o.argument == nullptr && false);
+	for (const sap::occurrence &o : results.occurrences("nothing"))
+		assert(o.argument == nullptr && false);
+
+	printf("Testing positionals\n");
+	const char *positionals[] = { "posarg", "posarg2", "extra" };
+	n = 0;
+	for (const sap::occurrence &o : results.positionals())
+		assert(o.value == sap::view(positionals[n++]));
+	assert(n == 3);
+	FREE_ARGV(10, argv1);
+
+	printf("Testing occurrences end where the parse fails\n");
+	char *argv3[4];
+	copy_argv(4, argv3, "ctests", "posarg", "--value", "--bflag");
+	assert(sap_parse_args(config, 4, argv3) == 1);
+	sap::results failed(config, 4, argv3);
+	n = 0;
+	for (const sap::occurrence &o : failed.occurrences())
+		n += o.argument == config.arguments + 1 ? 1 : 10;
+	assert(n == 1);
+	FREE_ARGV(4, argv3);
+
+	printf("C++ views testing passed\n\n");
+}
+
+/**
+ * @brief Test owned configurations copied from specified config
+ *
+ * @param config config
+ */
+void test_owner(SapConfig config)
+{
+	printf("Testing owned configurations...\n");
+
+	printf("Testing copy of configuration\n");
+	char name[] = "copied";
+	char section[] = "general";
+	const char *sections[] = { section };
+	config.name = name;
+	config.sections = sections;
+	config.sectioncount = 1;
+	sap::config owner(config);
+	name[0] = 'C'; // copy is independent of source strings
+	section[0] = 'G';
+	assert(std::strcmp(owner.get().name, "copied") == 0);
+	assert(owner.get().sections != sections);
+	assert(std::strcmp(owner.get().sections[0], "general") == 0);
+	assert(owner.get().arguments != config.arguments);
+	assert(owner.get().argcount == 7);
+	assert(std::strcmp(owner[2].longopt, "value") == 0);
+	assert(owner[2].longopt != config.arguments[2].longopt);
+	assert(owner.get().compiled != nullptr);
+
+	printf("Testing moves\n");
+	sap::config moved(std::move(owner));
+	assert(owner.get().arguments == nullptr && owner.get().argcount == 0);
+	owner = std::move(moved);
+	assert(moved.get().arguments == nullptr);
+
+	char *argv1[5];
+	copy_argv(5, argv1, "ctests", "-v", "value", "posarg", "posarg2");
+	assert(owner.parse(5, argv1) == 0);
+	assert(owner[2].set == 1);
+	assert(owner.results(5, argv1).value("value") == sap::view("value"));
+	assert(config.arguments[2].value != owner[2].value
+		|| !config.arguments[2].set); // source results untouched
+	FREE_ARGV(5, argv1);
+
+	printf("Testing construction from lists\n");
+	const unsigned int group[] = { 0, 1 };
+	SapArgument a = {}, b = {};
+	a.shortopt = 'a';
+	a.longopt = "aflag";
+	a.type = SAP_ARG_OPTION;
+	b.shortopt = 'b';
+	b.longopt = "bflag";
+	b.type = SAP_ARG_OPTION;
+	b.default_value = "off";
+	const char *const speeds[] = { "fast", "slow" };
+	SapArgument c = {};
+	c.shortopt = 'c';
+	c.longopt = "speed";
+	c.type = SAP_ARG_OPTION_VALUE;
+	c.choices = speeds;
+	c.choicecount = 2;
+	SapRule rule = {};
+	rule.type = SAP_RULE_EXACTLY_ONE;
+	rule.group = group;
+	rule.groupcount = 2;
+	sap::config listed("listed", 1, 0, 0, "Chua Hou", "List test",
+		{ a, b, c }, { rule });
+	assert(listed.get().argcount == 3 && listed.get().rulecount == 1);
+	assert(listed.get().rules[0].group != group);
+	assert(std::strcmp(listed[1].default_value, "off") == 0);
+	assert(listed[2].choices != speeds && listed[2].choices[1] != speeds[1]);
+	assert(std::strcmp(listed[2].choices[1], "slow") == 0);
+
+	char *argv2[2];
+	copy_argv(2, argv2, "listed", "-ab");
+	assert(listed.parse(2, argv2) != 0); // rule copied and compiled
+	FREE_ARGV(2, argv2);
+	char *argv3[2];
+	copy_argv(2, argv3, "listed", "-b");
+	assert(listed.parse(2, argv3) == 0);
+	FREE_ARGV(2, argv3);
+	char *argv5[4];
+	copy_argv(4, argv5, "listed", "-b", "--speed", "slow");
+	assert(listed.parse(4, argv5) == 0);
+	assert(listed.results(4, argv5).choice("speed") == 1);
+	FREE_ARGV(4, argv5);
+	char *argv6[4];
+	copy_argv(4, argv6, "listed", "-b", "--speed", "medium");
+	assert(listed.parse(4, argv6) != 0); // not one of the choices
+	FREE_ARGV(4, argv6);
+
+	printf("Testing end of options\n");
+	char *argv4[8];
+	copy_argv(8, argv4, "ctests", "-v", "value", "first", "--", "-a", "child",
+		"-b");
+	SapResult result;
+	assert(owner.parse(8, argv4, &result) == 0);
+	assert(result.tail_argc == 2 && result.tail_argv == argv4 + 6);
+	int count = 0;
+	for (const sap::occurrence &o : owner.results(8, argv4).occurrences())
+	{
+		assert(o.position < 6); // tail not visited
+		count++;
+	}
+	assert(count == 3);
+	count = 0;
+	for (const sap::occurrence &o : owner.results(8, argv4).positionals())
+	{
+		assert(o.argument == &owner[count == 0 ? 1 : 6]);
+		count++;
+	}
+	assert(count == 2);
+	FREE_ARGV(8, argv4);
+
+	printf("Owned configurations testing passed\n\n");
+}
+
 int main()
 {
 	// create config
@@ -298,9 +516,11 @@ int main()
 	test_value(config);
 	test_opt(config);
 	test_pos(config);
+	test_views(config);
+	test_owner(config);
 
 	// free config memory
-	delete config.arguments;
+	delete[] config.arguments;
 
 	return 0;
 }
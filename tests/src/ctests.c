@@ -10,6 +10,10 @@
 
 #include "sap.h"
 
+#ifdef __linux__
+	#include <unistd.h>
+#endif
+
 /**
  * @brief Set the up test configuration
  *
@@ -135,7 +139,7 @@ void copy_argv(int argc, char **argv, ...)
 	for (int i = 0; i < argc; i++)
 	{
 		const char *next = va_arg(strings, const char *);
-		argv[i] = malloc(sizeof(char) * (strlen(next))); // +1 for \0
+		argv[i] = malloc(sizeof(char) * (strlen(next) + 1)); // +1 for \0
 		strcpy(argv[i], next);
 	}
 	va_end(strings);
@@ -191,6 +195,23 @@ void test_value(SapConfig config)
 	assert(strcmp(config.arguments[2].value, "value") == 0);
 	FREE_ARGV(5, argv5);
 
+	printf("Testing longopt value after '='\n");
+	char *argv7[6];
+	copy_argv(6, argv7, "ctests", "--value=a=b", "posarg", "--cvalue=",
+		"posarg2", "--value=-5");
+	assert(sap_parse_args(config, 6, argv7) == 0);
+	assert(config.arguments[2].count == 2);
+	assert(config.arguments[2].value == argv7[5] + 8);
+	assert(config.arguments[4].value == argv7[3] + 9); // empty
+	assert(strcmp(config.arguments[1].value, "posarg") == 0);
+	argv7[5][7] = '\0'; // now --value, taking no value
+	assert(sap_parse_args(config, 6, argv7) != 0);
+	FREE_ARGV(6, argv7);
+	char *argv8[5];
+	copy_argv(5, argv8, "ctests", "-v", "value", "--aflag=on", "posarg");
+	assert(sap_parse_args(config, 5, argv8) != 0); // flags take no value
+	FREE_ARGV(5, argv8);
+
 	printf("Testing lack of required value\n");
 	char *argv6[5];
 	copy_argv(5, argv6, "ctests", "posarg", "--cvalue", "abc", "posarg2");
@@ -305,6 +326,1960 @@ void test_nonalpha(SapConfig config)
 	FREE_ARGV(5, argv2);
 }
 
+/**
+ * @brief Checks that an incremental parse matches parsing its tokens afresh
+ * with sap_parse_args()
+ *
+ * @param state incremental parse to check
+ */
+void check_incremental(SapIncremental *state)
+{
+	// parse the same tokens into a separate set of arguments
+	SapConfig config = state->config;
+	SapArgument arguments[config.argcount];
+	memcpy(arguments, config.arguments, sizeof(SapArgument) * config.argcount);
+	config.arguments = arguments;
+
+	char *argv[state->count + 1];
+	argv[0] = "ctests";
+	for (unsigned int i = 0; i < state->count; i++)
+		argv[i + 1] = (char *) state->tokens[i].text;
+
+	int status = sap_parse_args(config, state->count + 1, argv);
+	assert(sap_incr_status(state) == status);
+
+	// results are only complete for valid command lines
+	if (status != 0) return;
+	for (unsigned int i = 0; i < config.argcount; i++)
+	{
+		assert(state->config.arguments[i].set == arguments[i].set);
+		assert(state->config.arguments[i].count == arguments[i].count);
+		if (arguments[i].set)
+			assert(state->config.arguments[i].value == arguments[i].value);
+		if (arguments[i].set && arguments[i].choicecount)
+			assert(state->config.arguments[i].choice == arguments[i].choice);
+	}
+}
+
+/**
+ * @brief Test incremental parsing with specified config
+ *
+ * @param config config
+ */
+void test_incremental(SapConfig config)
+{
+	printf("Testing incremental parsing...\n");
+
+	SapIncremental state;
+	size_t size = sap_incr_size(config, 100);
+	void *memory = malloc(size);
+	assert(sap_incr_init(&state, config, memory, size - 1, 100) != 0);
+	assert(sap_incr_init(&state, config, memory, size, 100) == 0);
+
+	printf("Testing insertion\n");
+	assert(sap_incr_insert(&state, 0, "posarg") == 0);
+	assert(sap_incr_insert(&state, 1, "posarg2") == 0);
+	assert(config.arguments[1].set == 1);
+	assert(strcmp(config.arguments[1].value, "posarg") == 0);
+	assert(strcmp(config.arguments[6].value, "posarg2") == 0);
+	assert(sap_incr_status(&state) != 0); // -v is required
+	check_incremental(&state);
+	assert(sap_incr_insert(&state, 2, "-v") == 0);
+	assert(sap_incr_status(&state) != 0); // -v has no value
+	check_incremental(&state);
+	assert(sap_incr_insert(&state, 3, "value") == 0);
+	assert(sap_incr_status(&state) == 0);
+	assert(strcmp(config.arguments[2].value, "value") == 0);
+	check_incremental(&state);
+	assert(sap_incr_insert(&state, 0, "-ab") == 0);
+	assert(config.arguments[3].set == 1);
+	assert(config.arguments[5].set == 1);
+	check_incremental(&state);
+
+	printf("Testing renumbering of positionals\n");
+	assert(sap_incr_insert(&state, 1, "-c") == 0); // takes posarg as value
+	assert(strcmp(config.arguments[4].value, "posarg") == 0);
+	assert(strcmp(config.arguments[1].value, "posarg2") == 0);
+	assert(config.arguments[6].set == 0);
+	assert(sap_incr_status(&state) != 0);
+	check_incremental(&state);
+	assert(sap_incr_insert(&state, 1, "first") == 0);
+	assert(strcmp(config.arguments[1].value, "first") == 0);
+	assert(strcmp(config.arguments[6].value, "posarg2") == 0);
+	assert(sap_incr_status(&state) == 0);
+	check_incremental(&state);
+
+	printf("Testing replacement and removal\n");
+	assert(sap_incr_replace(&state, 2, "-b") == 0); // posarg now positional
+	assert(config.arguments[4].set == 0);
+	assert(strcmp(config.arguments[6].value, "posarg") == 0);
+	check_incremental(&state);
+	assert(sap_incr_replace(&state, 0, "-vc") == 0);
+	assert(sap_incr_status(&state) != 0);
+	check_incremental(&state);
+	assert(sap_incr_remove(&state, 0) == 0);
+	assert(config.arguments[3].set == 0);
+	assert(sap_incr_status(&state) == 0);
+	check_incremental(&state);
+	assert(sap_incr_remove(&state, state.count) != 0);
+	assert(sap_incr_replace(&state, state.count, "x") != 0);
+	assert(sap_incr_insert(&state, state.count + 1, "x") != 0);
+
+	printf("Testing repeated options\n");
+	unsigned int end = state.count;
+	assert(sap_incr_insert(&state, end, "--value") == 0);
+	assert(sap_incr_insert(&state, end + 1, "again") == 0);
+	assert(strcmp(config.arguments[2].value, "again") == 0);
+	check_incremental(&state);
+	assert(sap_incr_remove(&state, end + 1) == 0);
+	assert(sap_incr_status(&state) != 0);
+	check_incremental(&state);
+	assert(sap_incr_remove(&state, end) == 0);
+	assert(strcmp(config.arguments[2].value, "value") == 0);
+	check_incremental(&state);
+
+	printf("Testing values after '='\n");
+	assert(sap_incr_insert(&state, end, "--value=inline") == 0);
+	assert(strcmp(config.arguments[2].value, "inline") == 0);
+	assert(sap_incr_status(&state) == 0);
+	check_incremental(&state);
+	assert(sap_incr_insert(&state, end + 1, "posarg3") == 0); // extra
+	assert(strcmp(config.arguments[2].value, "inline") == 0);
+	check_incremental(&state);
+	assert(sap_incr_insert(&state, 0, "--value") == 0); // takes a token
+	assert(sap_incr_status(&state) == 0);
+	check_incremental(&state);
+	assert(sap_incr_replace(&state, end + 2, "--value=last") == 0);
+	assert(strcmp(config.arguments[2].value, "last") == 0);
+	check_incremental(&state);
+	assert(sap_incr_replace(&state, end + 2, "--aflag=on") == 0);
+	assert(sap_incr_status(&state) != 0);
+	check_incremental(&state);
+	assert(sap_incr_remove(&state, end + 2) == 0);
+	assert(strcmp(config.arguments[2].value, "inline") == 0);
+	check_incremental(&state);
+	assert(sap_incr_remove(&state, 0) == 0);
+	assert(sap_incr_remove(&state, end) == 0);
+	assert(strcmp(config.arguments[2].value, "value") == 0);
+	assert(sap_incr_status(&state) == 0);
+	check_incremental(&state);
+
+	printf("Testing many edits at one position\n");
+	while (state.count < 90)
+	{
+		assert(sap_incr_insert(&state, 1, "extra") == 0);
+		assert(sap_incr_insert(&state, 1, "-a") == 0);
+		check_incremental(&state);
+	}
+	while (state.count > 0)
+	{
+		assert(sap_incr_remove(&state, state.count / 2) == 0);
+		check_incremental(&state);
+	}
+	for (unsigned int i = 0; i < config.argcount; i++)
+		assert(config.arguments[i].set == 0);
+
+	printf("Testing unknown options\n");
+	config.flags |= SAP_FLAG_STRICT;
+	assert(sap_incr_init(&state, config, memory, size, 100) == 0);
+	assert(sap_incr_insert(&state, 0, "-v") == 0);
+	assert(sap_incr_insert(&state, 1, "value") == 0);
+	assert(sap_incr_insert(&state, 2, "posarg") == 0);
+	assert(sap_incr_insert(&state, 3, "posarg2") == 0);
+	assert(sap_incr_status(&state) == 0);
+	assert(sap_incr_insert(&state, 2, "-x") == 0);
+	assert(sap_incr_status(&state) != 0);
+	check_incremental(&state);
+	assert(sap_incr_replace(&state, 2, "--nope") == 0);
+	assert(sap_incr_status(&state) != 0);
+	check_incremental(&state);
+	assert(sap_incr_remove(&state, 2) == 0);
+	assert(sap_incr_status(&state) == 0);
+	check_incremental(&state);
+
+	free(memory);
+
+	printf("Incremental parsing testing passed\n\n");
+}
+
+/**
+ * @brief Test constraints between arguments with specified config
+ *
+ * @param config config
+ */
+void test_rules(SapConfig config)
+{
+	printf("Testing constraints...\n");
+
+	// -a and -b exclusive, -h not with -c, -c needs -a
+	unsigned int flags[] = { 3, 5 };
+	unsigned int help[] = { 4 };
+	unsigned int cvalue[] = { 3 };
+	SapRule rules[] =
+	{
+		{ .type = SAP_RULE_EXACTLY_ONE, .group = flags, .groupcount = 2 },
+		{ .type = SAP_RULE_CONFLICTS, .arg = 0, .group = help,
+			.groupcount = 1 },
+		{ .type = SAP_RULE_REQUIRES, .arg = 4, .group = cvalue,
+			.groupcount = 1 },
+		{ .type = SAP_RULE_AT_LEAST_ONE, .group = flags, .groupcount = 2 }
+	};
+	config.rules = rules;
+	config.rulecount = 4;
+
+	size_t size = sap_compile_size(config);
+	void *memory = malloc(size);
+
+	// run each test uncompiled, then compiled
+	for (int compiled = 0; compiled < 2; compiled++)
+	{
+		if (compiled)
+		{
+			printf("Testing compiled constraints\n");
+			assert(sap_compile(&config, memory, size - 1) != 0);
+			assert(sap_compile(&config, memory, size) == 0);
+			assert(config.compiled != NULL);
+		}
+
+		printf("Testing exactly one\n");
+		char *argv1[6];
+		copy_argv(6, argv1, "ctests", "-v", "value", "posarg", "posarg2",
+			"-a");
+		assert(sap_parse_args(config, 6, argv1) == 0);
+		FREE_ARGV(6, argv1);
+		char *argv2[6];
+		copy_argv(6, argv2, "ctests", "-v", "value", "posarg", "posarg2",
+			"-ab");
+		assert(sap_parse_args(config, 6, argv2) != 0);
+		FREE_ARGV(6, argv2);
+		char *argv3[5];
+		copy_argv(5, argv3, "ctests", "-v", "value", "posarg", "posarg2");
+		assert(sap_parse_args(config, 5, argv3) != 0);
+		FREE_ARGV(5, argv3);
+
+		printf("Testing conflicts and requires\n");
+		char *argv4[8];
+		copy_argv(8, argv4, "ctests", "-v", "value", "posarg", "posarg2",
+			"-a", "-c", "cvalue");
+		assert(sap_parse_args(config, 8, argv4) == 0);
+		FREE_ARGV(8, argv4);
+		char *argv5[8];
+		copy_argv(8, argv5, "ctests", "-v", "value", "posarg", "posarg2",
+			"-ah", "-c", "cvalue");
+		assert(sap_parse_args(config, 8, argv5) != 0);
+		FREE_ARGV(8, argv5);
+		char *argv6[8];
+		copy_argv(8, argv6, "ctests", "-v", "value", "posarg", "posarg2",
+			"-b", "-c", "cvalue");
+		assert(sap_parse_args(config, 8, argv6) != 0);
+		FREE_ARGV(8, argv6);
+
+		printf("Testing required arguments\n");
+		char *argv7[4];
+		copy_argv(4, argv7, "ctests", "-a", "posarg", "posarg2");
+		assert(sap_parse_args(config, 4, argv7) != 0);
+		FREE_ARGV(4, argv7);
+	}
+
+	printf("Testing incremental constraints\n");
+	SapIncremental state;
+	size_t incrsize = sap_incr_size(config, 8);
+	void *incrmemory = malloc(incrsize);
+	assert(sap_incr_init(&state, config, incrmemory, incrsize, 8) == 0);
+	assert(sap_incr_insert(&state, 0, "-v") == 0);
+	assert(sap_incr_insert(&state, 1, "value") == 0);
+	assert(sap_incr_insert(&state, 2, "posarg") == 0);
+	assert(sap_incr_insert(&state, 3, "posarg2") == 0);
+	check_incremental(&state);
+	assert(sap_incr_status(&state) != 0);
+	assert(sap_incr_insert(&state, 4, "-ab") == 0);
+	check_incremental(&state);
+	assert(sap_incr_status(&state) != 0);
+	assert(sap_incr_replace(&state, 4, "-b") == 0);
+	check_incremental(&state);
+	assert(sap_incr_status(&state) == 0);
+	free(incrmemory);
+
+	printf("Testing invalid rule\n");
+	rules[1].arg = config.argcount;
+	assert(sap_compile(&config, memory, size) != 0);
+	config.compiled = NULL;
+	char *argv8[6];
+	copy_argv(6, argv8, "ctests", "-v", "value", "posarg", "posarg2", "-a");
+	assert(sap_parse_args(config, 6, argv8) != 0);
+	FREE_ARGV(6, argv8);
+
+	free(memory);
+
+	printf("Constraints testing passed\n\n");
+}
+
+/**
+ * @brief Test default values with specified config
+ *
+ * @param config config
+ */
+void test_defaults(SapConfig config)
+{
+	printf("Testing default values...\n");
+
+	SapArgument *cvalue = config.arguments + 4;
+	cvalue->default_value = "42";
+
+	printf("Testing unset argument\n");
+	char *argv1[5];
+	copy_argv(5, argv1, "ctests", "-v", "1.5", "posarg", "posarg2");
+	assert(sap_parse_args(config, 5, argv1) == 0);
+	assert(cvalue->set == 0);
+	assert(strcmp(sap_get_value(cvalue), "42") == 0);
+	long l;
+	double d;
+	assert(sap_get_long(cvalue, &l) == 0 && l == 42);
+	assert(sap_get_double(cvalue, &d) == 0 && d == 42.0);
+
+	printf("Testing set argument\n");
+	assert(strcmp(sap_get_value(config.arguments + 2), "1.5") == 0);
+	assert(sap_get_long(config.arguments + 2, &l) != 0);
+	assert(sap_get_double(config.arguments + 2, &d) == 0 && d == 1.5);
+	FREE_ARGV(5, argv1);
+
+	char *argv2[7];
+	copy_argv(7, argv2, "ctests", "-v", "value", "-c", "0x10", "posarg",
+		"posarg2");
+	assert(sap_parse_args(config, 7, argv2) == 0);
+	assert(strcmp(sap_get_value(cvalue), "0x10") == 0);
+	assert(sap_get_long(cvalue, &l) == 0 && l == 16);
+	assert(sap_get_long(config.arguments + 2, &l) != 0);
+	FREE_ARGV(7, argv2);
+
+	printf("Testing argument without default\n");
+	assert(sap_get_value(config.arguments + 0) == NULL);
+	assert(sap_get_long(config.arguments + 0, &l) != 0);
+
+	printf("Testing values out of range\n");
+	SapArgument *unset = config.arguments + 0;
+	unset->default_value = "99999999999999999999999";
+	assert(sap_get_long(unset, &l) != 0);
+	unset->default_value = "1e999";
+	assert(sap_get_double(unset, &d) != 0);
+	unset->default_value = "-1e999";
+	assert(sap_get_double(unset, &d) != 0);
+	unset->default_value = NULL;
+
+	cvalue->default_value = NULL;
+
+	printf("Default values testing passed\n\n");
+}
+
+/**
+ * @brief Test classification of negative numbers and UTF-8 short options with
+ * specified config
+ *
+ * @param config config
+ */
+void test_classification(SapConfig config)
+{
+	printf("Testing token classification...\n");
+
+	printf("Testing negative numbers\n");
+	char *argv1[5];
+	copy_argv(5, argv1, "ctests", "-v", "-5", "posarg", "posarg2");
+	assert(sap_parse_args(config, 5, argv1) != 0);
+	config.flags = SAP_FLAG_NUMBERS;
+	assert(sap_parse_args(config, 5, argv1) == 0);
+	assert(strcmp(config.arguments[2].value, "-5") == 0);
+	FREE_ARGV(5, argv1);
+	char *argv2[5];
+	copy_argv(5, argv2, "ctests", "-v", "value", "-.5", "-1.5e+3");
+	assert(sap_parse_args(config, 5, argv2) == 0);
+	assert(strcmp(config.arguments[1].value, "-.5") == 0);
+	assert(strcmp(config.arguments[6].value, "-1.5e+3") == 0);
+	FREE_ARGV(5, argv2);
+	char *argv3[6];
+	copy_argv(6, argv3, "ctests", "-v", "value", "posarg", "posarg2", "-5x");
+	assert(sap_parse_args(config, 6, argv3) != 0);
+	FREE_ARGV(6, argv3);
+	config.flags = 0;
+
+	printf("Testing UTF-8 short options\n");
+	SapArgument arguments[9];
+	memcpy(arguments, config.arguments, sizeof(SapArgument) * 7);
+	SapArgument eflag =
+	{
+		.wideopt = 0xE9, // e with acute accent
+		.longopt = "eflag",
+		.type = SAP_ARG_OPTION,
+		.help = "Flag E"
+	};
+	SapArgument lvalue =
+	{
+		.wideopt = 0x3BB, // lambda
+		.longopt = "lvalue",
+		.type = SAP_ARG_OPTION_VALUE,
+		.help = "Lambda value"
+	};
+	arguments[7] = eflag;
+	arguments[8] = lvalue;
+	config.arguments = arguments;
+	config.argcount = 9;
+
+	char *argv4[8];
+	copy_argv(8, argv4, "ctests", "-v", "value", "posarg", "posarg2",
+		"-a\xC3\xA9", "-\xCE\xBB", "lambda");
+	assert(sap_parse_args(config, 8, argv4) == 0);
+	assert(arguments[3].set == 1);
+	assert(arguments[7].set == 1);
+	assert(arguments[8].set == 1);
+	assert(strcmp(arguments[8].value, "lambda") == 0);
+	FREE_ARGV(8, argv4);
+	char *argv5[7];
+	copy_argv(7, argv5, "ctests", "-v", "value", "posarg", "posarg2",
+		"-\xC3\xA9\xCE\xBB", "lambda");
+	assert(sap_parse_args(config, 7, argv5) != 0);
+	FREE_ARGV(7, argv5);
+
+	printf("Testing incremental UTF-8 short options\n");
+	SapIncremental state;
+	size_t size = sap_incr_size(config, 8);
+	void *memory = malloc(size);
+	assert(sap_incr_init(&state, config, memory, size, 8) == 0);
+	const char *tokens[] = { "-\xCE\xBB", "lambda", "-v", "value", "posarg",
+		"posarg2", "-\xC3\xA9" };
+	for (unsigned int i = 0; i < 7; i++)
+	{
+		assert(sap_incr_insert(&state, i, tokens[i]) == 0);
+		check_incremental(&state);
+	}
+	assert(sap_incr_status(&state) == 0);
+	assert(arguments[7].set == 1);
+	assert(sap_incr_replace(&state, 0, "-\xCE\xBB\xC3\xA9") == 0);
+	check_incremental(&state);
+	assert(sap_incr_status(&state) != 0);
+	free(memory);
+
+	printf("Token classification testing passed\n\n");
+}
+
+/**
+ * @brief Test end of options and the tail left after it with specified config
+ *
+ * @param config config
+ */
+void test_tail(SapConfig config)
+{
+	printf("Testing end of options...\n");
+
+	printf("Testing -- terminator\n");
+	SapResult result;
+	char *argv1[9];
+	copy_argv(8, argv1, "ctests", "-v", "value", "first", "--", "-a", "child",
+		"--flag");
+	argv1[8] = NULL;
+	assert(sap_parse(config, 8, argv1, &result) == 0);
+	assert(strcmp(config.arguments[1].value, "first") == 0);
+	assert(strcmp(config.arguments[6].value, "-a") == 0);
+	assert(config.arguments[3].set == 0);
+	assert(result.tail_argc == 2);
+	assert(result.tail_argv == argv1 + 6);
+	assert(result.tail_argv[2] == NULL);
+	assert(sap_parse_args(config, 8, argv1) == 0);
+	FREE_ARGV(8, argv1);
+	char *argv2[5];
+	copy_argv(5, argv2, "ctests", "first", "second", "-v", "--");
+	assert(sap_parse(config, 5, argv2, &result) != 0); // -v has no value
+	FREE_ARGV(5, argv2);
+	char *argv3[6];
+	copy_argv(6, argv3, "ctests", "-v", "value", "first", "second", "--");
+	assert(sap_parse(config, 6, argv3, &result) == 0);
+	assert(result.tail_argc == 0);
+	assert(result.tail_argv == argv3 + 6);
+	FREE_ARGV(6, argv3);
+
+	printf("Testing stop at first positional\n");
+	config.flags = SAP_FLAG_STOP;
+	char *argv4[7];
+	copy_argv(7, argv4, "ctests", "-v", "value", "first", "second", "-a",
+		"-5");
+	assert(sap_parse(config, 7, argv4, &result) == 0);
+	assert(strcmp(config.arguments[1].value, "first") == 0);
+	assert(strcmp(config.arguments[6].value, "second") == 0);
+	assert(config.arguments[3].set == 0);
+	assert(result.tail_argc == 2);
+	assert(result.tail_argv == argv4 + 5);
+	FREE_ARGV(7, argv4);
+	char *argv5[5];
+	copy_argv(5, argv5, "ctests", "first", "-v", "value", "second");
+	assert(sap_parse(config, 5, argv5, &result) != 0); // -v is positional
+	FREE_ARGV(5, argv5);
+
+	printf("Testing incremental end of options\n");
+	const char *pool[] = { "--", "-v", "value", "pos", "-a", "-c", "-x" };
+	unsigned int seed = 1;
+	for (unsigned int flags = 0; flags <= SAP_FLAG_STOP;
+		flags += SAP_FLAG_STOP)
+	{
+		config.flags = flags;
+		SapIncremental state;
+		size_t size = sap_incr_size(config, 12);
+		void *memory = malloc(size);
+		assert(sap_incr_init(&state, config, memory, size, 12) == 0);
+		for (unsigned int step = 0; step < 2000; step++)
+		{
+			seed = seed * 1103515245 + 12345;
+			unsigned int r = seed >> 16;
+			const char *token = pool[r % 7];
+			unsigned int index = (r / 7) % (state.count + 1);
+			if (state.count < 12 && (r / 64) % 3 == 0)
+				assert(sap_incr_insert(&state, index, token) == 0);
+			else if (index < state.count && (r / 64) % 3 == 1)
+				assert(sap_incr_remove(&state, index) == 0);
+			else if (index < state.count)
+				assert(sap_incr_replace(&state, index, token) == 0);
+			check_incremental(&state);
+		}
+		free(memory);
+	}
+
+	printf("End of options testing passed\n\n");
+}
+
+/**
+ * @brief Test compiled lookups in a large generated configuration
+ */
+void test_large()
+{
+	printf("Testing large configurations...\n");
+
+	// options o0 to o999, every third valued, short options from a-z and
+	// Greek letters, two positional arguments at the end
+	unsigned int count = 1002;
+	SapArgument *arguments = calloc(count, sizeof(SapArgument));
+	char (*names)[8] = malloc(8 * count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		snprintf(names[i], 8, "o%u", i);
+		arguments[i].longopt = names[i];
+		arguments[i].help = "Generated option";
+		arguments[i].type = i % 3 == 2 ? SAP_ARG_OPTION_VALUE : SAP_ARG_OPTION;
+		if (i < 26) arguments[i].shortopt = 'a' + i;
+		else if (i < 50) arguments[i].wideopt = 0x3B1 + i - 26;
+	}
+	arguments[count - 2].type = SAP_ARG_POSITIONAL;
+	arguments[count - 1].type = SAP_ARG_POSITIONAL;
+	arguments[count - 1].shortopt = 0;
+	arguments[999].shortopt = 'a'; // repeated, the first still wins
+	arguments[996].wideopt = 0x3B2;
+	arguments[998].longopt = "o0";
+
+	SapConfig config = { .name = "large", .arguments = arguments,
+		.argcount = count };
+	SapConfig compiled = config;
+	size_t size = sap_compile_size(config);
+	void *memory = malloc(size);
+	assert(sap_compile(&compiled, memory, size) == 0);
+
+	SapArgument copy[count];
+	char *argv1[9];
+	copy_argv(9, argv1, "large", "--o500", "value", "-ab\xCE\xB2", "--o0",
+		"--o997", "--nothing", "first", "second");
+	char *argv2[4];
+	copy_argv(4, argv2, "large", "-c", "value", "first");
+	char *argv3[3];
+	copy_argv(3, argv3, "large", "first", "second");
+	char **argvs[] = { argv1, argv2, argv3 };
+	int argcs[] = { 9, 4, 3 };
+	for (unsigned int k = 0; k < 3; k++)
+	{
+		// same results as scanning the arguments
+		int status = sap_parse_args(config, argcs[k], argvs[k]);
+		memcpy(copy, arguments, sizeof(SapArgument) * count);
+		assert(sap_parse_args(compiled, argcs[k], argvs[k]) == status);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			assert(arguments[i].set == copy[i].set);
+			assert(arguments[i].value == copy[i].value);
+		}
+	}
+	assert(arguments[999].set == 0 && arguments[998].set == 0);
+	assert(arguments[count - 2].set == 1);
+
+	printf("Testing set cleared for arguments of previous parse\n");
+	SapWord setbits[SAP_WORDS(count)];
+	memset(setbits, 0, sizeof(setbits));
+	SapConfig marked = compiled;
+	marked.setbits = setbits;
+	assert(sap_parse_args(marked, 9, argv1) == 0);
+	assert(arguments[0].set && arguments[27].set && arguments[997].set);
+	assert(arguments[996].set == 0);
+	assert(sap_parse_args(marked, 3, argv3) == 0);
+	for (unsigned int i = 0; i < count - 2; i++)
+		assert(arguments[i].set == 0);
+	assert(sap_parse_args(config, 9, argv1) == 0); // uncompiled, unmarked
+	assert(sap_parse_args(compiled, 3, argv3) == 0);
+	for (unsigned int i = 0; i < count - 2; i++)
+		assert(arguments[i].set == 0 && arguments[i].count == 0);
+
+	printf("Testing compiled configuration shared by copies of arguments\n");
+	SapConfig other = compiled;
+	other.arguments = copy;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		copy[i] = arguments[i];
+		copy[i].set = 0;
+	}
+	assert(sap_parse_args(other, 9, argv1) == 0);
+	assert(sap_parse_args(compiled, 3, argv3) == 0);
+	assert(copy[0].set && copy[500].set && copy[997].set);
+	assert(sap_parse_args(other, 3, argv3) == 0);
+	for (unsigned int i = 0; i < count - 2; i++)
+		assert(copy[i].set == 0 && copy[i].count == 0);
+
+	FREE_ARGV(9, argv1);
+	FREE_ARGV(4, argv2);
+	FREE_ARGV(3, argv3);
+	free(memory);
+	free(names);
+	free(arguments);
+
+	printf("Large configuration testing passed\n\n");
+}
+
+/**
+ * @brief Test registration of arguments one at a time with specified config
+ *
+ * @param config config
+ */
+void test_registry(SapConfig config)
+{
+	printf("Testing registry...\n");
+
+	SapRegistry registry;
+	assert(sap_registry_init(&registry, config) == 0);
+	assert(registry.config.argcount == 7);
+	assert(registry.config.arguments != config.arguments);
+	assert(registry.config.compiled != NULL);
+	assert(strcmp(registry.config.name, "ctests") == 0);
+	assert(sap_registry_find(&registry, "value") == 2);
+	assert(sap_registry_find(&registry, "nothing") == -1);
+
+	printf("Testing namespaced arguments from plugins\n");
+	char name[16], help[16];
+	for (unsigned int i = 0; i < 5000; i++)
+	{
+		char group[8];
+		snprintf(group, sizeof(group), "plugin%u", i % 10);
+		snprintf(name, sizeof(name), "opt%u", i / 10);
+		snprintf(help, sizeof(help), "Option %u", i);
+		SapArgument arg =
+		{
+			.longopt = name,
+			.type = i % 2 ? SAP_ARG_OPTION_VALUE : SAP_ARG_OPTION,
+			.help = help
+		};
+		assert(sap_config_add(&registry, group, &arg) == (int) i + 7);
+	}
+	strcpy(name, "changed"); // strings were copied
+	assert(strcmp(registry.config.arguments[5006].longopt, "plugin9.opt499")
+		== 0);
+	assert(strcmp(registry.config.arguments[5006].help, "Option 4999") == 0);
+	assert(sap_registry_find(&registry, "plugin3.opt42") == 7 + 423);
+
+	printf("Testing taken options\n");
+	SapArgument taken = { .longopt = "opt0", .type = SAP_ARG_OPTION };
+	assert(sap_config_add(&registry, "plugin0", &taken) == -1);
+	taken.longopt = "fresh";
+	taken.shortopt = 'v';
+	assert(sap_config_add(&registry, NULL, &taken) == -1);
+	taken.shortopt = 'z';
+	assert(sap_config_add(&registry, NULL, &taken) == 5007);
+	assert(sap_registry_find(&registry, "fresh") == 5007);
+	taken.longopt = "wide";
+	taken.wideopt = 0x3B1; // alpha, used instead of shortopt
+	assert(sap_config_add(&registry, NULL, &taken) == 5008);
+	taken.longopt = "wider";
+	assert(sap_config_add(&registry, NULL, &taken) == -1);
+	taken.longopt = "POSITIONALARG1"; // names of positional arguments too
+	taken.wideopt = 0;
+	taken.shortopt = 0;
+	assert(sap_config_add(&registry, NULL, &taken) == -1);
+
+	printf("Testing parsing registered arguments\n");
+	char *argv1[8];
+	copy_argv(8, argv1, "ctests", "-v", "value", "posarg", "posarg2",
+		"--plugin2.opt42", "--plugin4.opt7", "-z\xCE\xB1");
+	assert(sap_parse_args(registry.config, 8, argv1) == 0);
+	assert(registry.config.arguments[7 + 422].set == 1);
+	assert(registry.config.arguments[7 + 74].set == 1);
+	assert(registry.config.arguments[5007].set == 1);
+	assert(registry.config.arguments[5008].set == 1);
+	SapConfig uncompiled = registry.config;
+	uncompiled.compiled = NULL;
+	assert(sap_parse_args(uncompiled, 8, argv1) == 0);
+	assert(registry.config.arguments[5008].set == 1);
+	SapConfig compiled = registry.config;
+	size_t size = sap_compile_size(compiled);
+	void *memory = malloc(size);
+	assert(sap_compile(&compiled, memory, size) == 0);
+	assert(sap_parse_args(compiled, 8, argv1) == 0);
+	assert(registry.config.arguments[7 + 74].set == 1);
+	free(memory);
+
+	printf("Testing rules set on registered arguments\n");
+	const unsigned int flags[] = { 3, 5 };
+	SapRule rules[] =
+	{
+		{ .type = SAP_RULE_AT_LEAST_ONE, .group = flags, .groupcount = 2 }
+	};
+	SapConfig ruled = registry.config;
+	ruled.rules = rules;
+	ruled.rulecount = 1;
+	SapResult result;
+	assert(sap_parse(ruled, 8, argv1, &result) == 1);
+	assert(result.error.kind == SAP_ERROR_CONFIG);
+	FREE_ARGV(8, argv1);
+
+	printf("Testing short options alone and moved registry\n");
+	SapArgument shortonly = { .shortopt = 'y', .type = SAP_ARG_OPTION };
+	assert(sap_config_add(&registry, "plugin0", &shortonly) == 5009);
+	assert(registry.config.arguments[5009].longopt == NULL);
+	SapRegistry moved;
+	memcpy(&moved, &registry, sizeof(SapRegistry));
+	memset(&registry, 0, sizeof(SapRegistry));
+	char *argv2[6];
+	copy_argv(6, argv2, "ctests", "-y", "-v", "value", "posarg", "posarg2");
+	assert(sap_parse_args(moved.config, 6, argv2) == 0);
+	assert(moved.config.arguments[5009].set == 1);
+	FREE_ARGV(6, argv2);
+	registry = moved;
+
+	sap_registry_free(&registry);
+	assert(registry.config.arguments == NULL);
+
+	printf("Registry testing passed\n\n");
+}
+
+/**
+ * @brief Test counting of repeated arguments with specified config
+ *
+ * @param config config
+ */
+void test_count(SapConfig config)
+{
+	printf("Testing occurrence counts...\n");
+
+	char *argv1[8];
+	copy_argv(8, argv1, "ctests", "-aaa", "-v", "value", "-ba", "posarg",
+		"--aflag", "posarg2");
+	assert(sap_parse_args(config, 8, argv1) == 0);
+	assert(config.arguments[3].count == 5);
+	assert(config.arguments[5].count == 1);
+	assert(config.arguments[2].count == 1);
+	assert(config.arguments[1].count == 1);
+	assert(config.arguments[0].count == 0);
+	FREE_ARGV(8, argv1);
+
+	char *argv2[7];
+	copy_argv(7, argv2, "ctests", "-v", "one", "posarg", "--value", "two",
+		"posarg2");
+	assert(sap_parse_args(config, 7, argv2) == 0);
+	assert(config.arguments[2].count == 2);
+	assert(config.arguments[3].count == 0); // reset by new parse
+	FREE_ARGV(7, argv2);
+
+	printf("Testing incremental occurrence counts\n");
+	SapIncremental state;
+	size_t size = sap_incr_size(config, 8);
+	void *memory = malloc(size);
+	assert(sap_incr_init(&state, config, memory, size, 8) == 0);
+	const char *tokens[] = { "-v", "value", "-aba", "posarg", "posarg2",
+		"-a" };
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		assert(sap_incr_insert(&state, i, tokens[i]) == 0);
+		check_incremental(&state);
+	}
+	assert(config.arguments[3].count == 3);
+	assert(sap_incr_remove(&state, 2) == 0);
+	assert(config.arguments[3].count == 1);
+	check_incremental(&state);
+	free(memory);
+
+	printf("Occurrence count testing passed\n\n");
+}
+
+/**
+ * @brief Test cache of parsed command lines with specified config
+ *
+ * @param config config
+ */
+void test_cache(SapConfig config)
+{
+	printf("Testing parse cache...\n");
+
+	SapCache cache;
+	size_t size = sap_cache_size(config, 2, 64);
+	void *memory = malloc(size);
+	assert(sap_cache_init(&cache, config, memory, size - 1, 2, 64) != 0);
+	assert(sap_cache_init(&cache, config, memory, size, 0, 64) != 0);
+	assert(sap_cache_init(&cache, config, memory, size, 2, 64) == 0);
+
+	printf("Testing repeated command lines\n");
+	SapResult result;
+	char *argv1[8];
+	copy_argv(8, argv1, "ctests", "-aa", "-v", "value", "posarg", "--",
+		"posarg2", "child");
+	assert(sap_cache_parse(&cache, 8, argv1, &result) == 0);
+	assert(cache.misses == 1 && cache.hits == 0);
+	char *argv2[8]; // same tokens in another buffer
+	copy_argv(8, argv2, "other", "-aa", "-v", "value", "posarg", "--",
+		"posarg2", "child");
+	config.arguments[5].set = 1; // stale results are cleared
+	assert(sap_cache_parse(&cache, 8, argv2, &result) == 0);
+	assert(cache.misses == 1 && cache.hits == 1);
+	assert(config.arguments[2].value == argv2[3]);
+	assert(config.arguments[1].value == argv2[4]);
+	assert(config.arguments[6].value == argv2[6]);
+	assert(config.arguments[3].count == 2);
+	assert(config.arguments[5].set == 0);
+	assert(result.tail_argc == 1 && result.tail_argv == argv2 + 7);
+
+	printf("Testing eviction and invalid command lines\n");
+	char *argv3[5];
+	copy_argv(5, argv3, "ctests", "-v", "value", "posarg", "posarg2");
+	char *argv4[6];
+	copy_argv(6, argv4, "ctests", "-v", "value", "-5", "posarg", "posarg2");
+	assert(sap_cache_parse(&cache, 5, argv3, NULL) == 0);
+	assert(sap_cache_parse(&cache, 6, argv4, NULL) != 0); // not remembered
+	assert(sap_cache_parse(&cache, 6, argv4, NULL) != 0);
+	assert(cache.misses == 4);
+	assert(sap_cache_parse(&cache, 8, argv1, NULL) == 0); // still there
+	assert(cache.hits == 2);
+	argv4[3][1] = 'b'; // now valid, takes place of argv3
+	assert(sap_cache_parse(&cache, 6, argv4, NULL) == 0);
+	assert(sap_cache_parse(&cache, 8, argv1, NULL) == 0);
+	assert(sap_cache_parse(&cache, 6, argv4, NULL) == 0);
+	assert(cache.hits == 4 && cache.misses == 5);
+	assert(sap_cache_parse(&cache, 5, argv3, NULL) == 0);
+	assert(cache.misses == 6);
+	assert(strcmp(config.arguments[6].value, "posarg2") == 0);
+	assert(config.arguments[5].set == 0);
+
+	printf("Testing values after '='\n");
+	char *argv6[4];
+	copy_argv(4, argv6, "ctests", "--value=value", "posarg", "posarg2");
+	char *argv7[4];
+	copy_argv(4, argv7, "other", "--value=value", "posarg", "posarg2");
+	assert(sap_cache_parse(&cache, 4, argv6, NULL) == 0);
+	assert(sap_cache_parse(&cache, 4, argv7, NULL) == 0);
+	assert(cache.hits == 5 && cache.misses == 7);
+	assert(config.arguments[2].value == argv7[1] + 8);
+	FREE_ARGV(4, argv6);
+	FREE_ARGV(4, argv7);
+
+	printf("Testing command lines too long to remember\n");
+	char *argv5[5];
+	copy_argv(5, argv5, "ctests", "-v", "a value longer than the rest",
+		"a positional argument", "another positional argument");
+	assert(sap_cache_parse(&cache, 5, argv5, NULL) == 0);
+	assert(sap_cache_parse(&cache, 5, argv5, NULL) == 0);
+	assert(cache.hits == 5 && cache.misses == 7);
+	assert(cache.unstored == 0);
+
+	FREE_ARGV(8, argv1);
+	FREE_ARGV(8, argv2);
+	FREE_ARGV(5, argv3);
+	FREE_ARGV(6, argv4);
+	FREE_ARGV(5, argv5);
+	free(memory);
+
+	printf("Parse cache testing passed\n\n");
+}
+
+#ifdef __linux__
+/**
+ * @brief Callback for sap_proc_sweep() in test_buffer(), counting processes
+ * and checking the command line of this one
+ */
+int check_process(int pid, int status, const SapResult *result,
+	const char *cmdline, size_t size, void *data)
+{
+	int *found = data;
+	assert(size > 0 && cmdline[size - 1] == '\0');
+	assert(result->tail_argv == NULL);
+	found[0]++;
+	if (pid == getpid())
+	{
+		assert(status == 0);
+		found[1] = 1;
+	}
+	return 0;
+}
+#endif
+
+/**
+ * @brief Test parsing of NUL-separated buffers with specified config
+ *
+ * @param config config
+ */
+void test_buffer(SapConfig config)
+{
+	printf("Testing buffer parsing...\n");
+
+	const char buffer[] = "ctests\0-v\0value\0-a\0posarg\0--\0posarg2\0child\0-x";
+	SapResult result;
+	assert(sap_parse_buffer(config, buffer, sizeof(buffer), &result) == 0);
+	assert(config.arguments[2].value == buffer + 10);
+	assert(config.arguments[3].set == 1);
+	assert(strcmp(config.arguments[6].value, "posarg2") == 0);
+	assert(result.tail_argc == 2 && result.tail_argv == NULL);
+	assert(result.tail_buffer == buffer + 37);
+	assert(result.tail_size == sizeof(buffer) - 37);
+	assert(sap_parse_buffer(config, buffer, 26, &result) != 0);
+	assert(result.tail_argc == 0 && result.tail_size == 0);
+	assert(sap_parse_buffer(config, buffer, 0, NULL) != 0);
+	const char invalid[] = "ctests\0-v\0value\0posarg\0posarg2\0-v";
+	assert(sap_parse_buffer(config, invalid, sizeof(invalid), NULL) != 0);
+
+	printf("Testing buffers read no further than their end\n");
+	const char tokens[] = "ctests\0posarg\0posarg2\0--value=a value past "
+		"a block";
+	char *exact = malloc(sizeof(tokens)); // nothing readable after it
+	memcpy(exact, tokens, sizeof(tokens));
+	assert(sap_parse_buffer(config, exact, sizeof(tokens), NULL) == 0);
+	assert(config.arguments[2].value == exact + 30);
+	free(exact);
+
+#ifdef __linux__
+	printf("Testing sweep of /proc\n");
+	SapArgument argument = { .longopt = "any", .type = SAP_ARG_OPTION };
+	SapConfig any = { .name = "any", .arguments = &argument, .argcount = 1 };
+	char cmdline[4096];
+	int found[2] = { 0, 0 };
+	assert(sap_proc_sweep(any, cmdline, 1, check_process, found) != 0);
+	assert(sap_proc_sweep(any, cmdline, sizeof(cmdline), check_process,
+		found) == 0);
+	assert(found[0] > 0 && found[1] == 1);
+#endif
+
+	printf("Buffer parsing testing passed\n\n");
+}
+
+/**
+ * @brief Tests choices of valued options with provided config
+ *
+ * @param config config
+ */
+void test_choices(SapConfig config)
+{
+	printf("Testing choices...\n");
+
+	// give --cvalue dozens of choices
+	char names[48][8];
+	const char *choices[48];
+	for (unsigned int c = 0; c < 48; c++)
+	{
+		snprintf(names[c], sizeof(names[c]), "mode%u", c);
+		choices[c] = names[c];
+	}
+	SapArgument arguments[7];
+	memcpy(arguments, config.arguments, sizeof(arguments));
+	config.arguments = arguments;
+	arguments[4].choices = choices;
+	arguments[4].choicecount = 48;
+	arguments[4].default_value = "mode7";
+
+	SapConfig compiled = config;
+	size_t size = sap_compile_size(compiled);
+	void *memory = malloc(size);
+	assert(sap_compile(&compiled, memory, size) == 0);
+	assert(compiled.compiled->choiceoffsets[4] != 0); // perfect hash found
+
+	char *argv1[7];
+	copy_argv(7, argv1, "ctests", "-v", "value", "-c", "mode31", "posarg",
+		"posarg2");
+	assert(sap_parse_args(config, 7, argv1) == 0);
+	assert(arguments[4].choice == 31);
+	assert(sap_get_choice(arguments + 4) == 31);
+	char *edited[7];
+	memcpy(edited, argv1, sizeof(edited));
+	for (unsigned int c = 0; c < 48; c++)
+	{
+		edited[4] = names[c];
+		assert(sap_parse_args(compiled, 7, edited) == 0);
+		assert(arguments[4].choice == (int) c);
+	}
+	edited[4] = "mode48";
+	assert(sap_parse_args(config, 7, edited) == 1);
+	assert(sap_parse_args(compiled, 7, edited) == 1);
+	edited[4] = "";
+	assert(sap_parse_args(compiled, 7, edited) == 1);
+	edited[3] = "--aflag"; // not given, falls back to default
+	edited[4] = "posarg";
+	assert(sap_parse_args(compiled, 7, edited) == 0);
+	assert(sap_get_choice(arguments + 4) == 7);
+	FREE_ARGV(7, argv1);
+
+	printf("Testing repeated choices\n");
+	const char *repeated[] = { "same", "other", "same" };
+	SapConfig fallback = config;
+	arguments[4].choices = repeated;
+	arguments[4].choicecount = 3;
+	size_t fallbacksize = sap_compile_size(fallback);
+	void *fallbackmemory = malloc(fallbacksize);
+	assert(sap_compile(&fallback, fallbackmemory, fallbacksize) == 0);
+	assert(fallback.compiled->choiceoffsets[4] == 0); // searched in order
+	char *argv2[7];
+	copy_argv(7, argv2, "ctests", "--cvalue", "same", "-v", "x", "posarg",
+		"posarg2");
+	assert(sap_parse_args(fallback, 7, argv2) == 0);
+	assert(arguments[4].choice == 0);
+	FREE_ARGV(7, argv2);
+	free(fallbackmemory);
+	arguments[4].choices = choices;
+	arguments[4].choicecount = 48;
+
+	printf("Testing completion of choices\n");
+	const char *matches[4];
+	assert(sap_complete_choices(arguments + 4, "mode4", matches, 4) == 9);
+	assert(strcmp(matches[0], "mode4") == 0);
+	assert(strcmp(matches[3], "mode42") == 0);
+	assert(sap_complete_choices(arguments + 4, "mode47", matches, 4) == 1);
+	assert(sap_complete_choices(arguments + 4, "x", NULL, 0) == 0);
+
+	printf("Testing incremental choices\n");
+	SapIncremental state;
+	size_t incrsize = sap_incr_size(compiled, 8);
+	void *incrmemory = malloc(incrsize);
+	assert(sap_incr_init(&state, compiled, incrmemory, incrsize, 8) == 0);
+	const char *tokens[] = { "-v", "x", "-c", "mode3", "posarg", "posarg2",
+		"-c", "mode5" };
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		assert(sap_incr_insert(&state, i, tokens[i]) == 0);
+		check_incremental(&state);
+	}
+	assert(arguments[4].choice == 5);
+	assert(sap_incr_replace(&state, 7, "nothing") == 0);
+	assert(sap_incr_status(&state) == 1);
+	check_incremental(&state);
+	assert(sap_incr_remove(&state, 7) == 0);
+	assert(sap_incr_remove(&state, 6) == 0);
+	assert(sap_incr_status(&state) == 0);
+	check_incremental(&state);
+	assert(arguments[4].choice == 3);
+	free(incrmemory);
+
+	printf("Testing registered choices\n");
+	SapRegistry registry;
+	assert(sap_registry_init(&registry, config) == 0);
+	SapArgument level =
+	{
+		.shortopt = 'l',
+		.longopt = "level",
+		.type = SAP_ARG_OPTION_VALUE,
+		.choices = repeated + 1,
+		.choicecount = 2
+	};
+	assert(sap_config_add(&registry, "log", &level) == 7);
+	const SapArgument *added = registry.config.arguments + 7;
+	assert(added->choices != level.choices); // choices were copied
+	assert(strcmp(added->choices[0], "other") == 0);
+	assert(strcmp(added->choices[1], "same") == 0);
+	assert(registry.config.arguments[4].choices != choices);
+	assert(strcmp(registry.config.arguments[4].choices[47], "mode47") == 0);
+	sap_registry_free(&registry);
+
+	free(memory);
+	printf("Choices testing passed\n\n");
+}
+
+/**
+ * @brief Tests rebuilding command lines with provided config
+ *
+ * @param config config
+ */
+void test_build(SapConfig config)
+{
+	printf("Testing rebuilding command lines...\n");
+
+	char *argv1[10];
+	copy_argv(10, argv1, "ctests", "-aa", "posarg", "-v", "value", "-b",
+		"--", "-x", "tail1", "tail2");
+	SapResult result;
+	assert(sap_parse(config, 10, argv1, &result) == 0);
+	assert(result.tail_argc == 2);
+
+	size_t size = sap_build_argv_size(config, "child", &result, NULL, 0);
+	void *memory = malloc(size);
+	int argc;
+	char **argv = sap_build_argv(config, "child", &result, NULL, 0, memory,
+		size, &argc);
+	assert(argv == memory);
+	const char *expected1[] = { "child", "--value", "value", "--aflag",
+		"--aflag", "--bflag", "--", "posarg", "-x", "tail1", "tail2" };
+	assert(argc == 11 && argv[11] == NULL);
+	for (int j = 0; j < argc; j++)
+	{
+		assert(strcmp(argv[j], expected1[j]) == 0);
+		assert((void *) argv[j] > memory
+			&& argv[j] < (char *) memory + size); // copied into memory
+	}
+	assert(argv[argc - 1] + strlen(argv[argc - 1]) + 1
+		== (char *) memory + size); // nothing left over
+
+	// the rebuilt command line parses to the same
+	SapArgument arguments[7];
+	memcpy(arguments, config.arguments, sizeof(arguments));
+	SapResult rebuilt;
+	assert(sap_parse(config, argc, argv, &rebuilt) == 0);
+	assert(rebuilt.tail_argc == 2);
+	for (unsigned int i = 0; i < 7; i++)
+	{
+		assert(config.arguments[i].set == arguments[i].set);
+		assert(config.arguments[i].count == arguments[i].count);
+		if (arguments[i].set && arguments[i].type != SAP_ARG_OPTION)
+			assert(strcmp(config.arguments[i].value, arguments[i].value)
+				== 0);
+	}
+	assert(sap_build_argv(config, "child", &result, NULL, 0, memory,
+		size - 1, NULL) == NULL); // too small
+	assert(sap_parse(config, 10, argv1, &result) == 0); // values from argv1
+	free(memory);
+
+	printf("Testing rebuilding with overrides\n");
+	SapOverride overrides[] =
+	{
+		{ .arg = 3, .set = 0 }, // no -a
+		{ .arg = 4, .set = 1, .value = "added" }, // -c added
+		{ .arg = 2, .set = 1, .value = "changed" }, // -v changed
+		{ .arg = 6, .set = 1, .value = "last" }
+	};
+	size = sap_build_argv_size(config, "child", NULL, overrides, 4);
+	memory = malloc(size);
+	argv = sap_build_argv(config, "child", NULL, overrides, 4, memory, size,
+		&argc);
+	const char *expected2[] = { "child", "--value", "changed", "--cvalue",
+		"added", "--bflag", "posarg", "last" }; // -- no longer needed
+	assert(argc == 8);
+	for (int j = 0; j < argc; j++) assert(strcmp(argv[j], expected2[j]) == 0);
+	free(memory);
+
+	printf("Testing rebuilding values looking like options\n");
+	overrides[1].value = "-oops"; // attached, as it is not a value alone
+	size = sap_build_argv_size(config, "child", NULL, overrides, 4);
+	memory = malloc(size);
+	argv = sap_build_argv(config, "child", NULL, overrides, 4, memory, size,
+		&argc);
+	assert(argc == 7 && strcmp(argv[3], "--cvalue=-oops") == 0);
+	assert(sap_parse_args(config, argc, argv) == 0);
+	assert(strcmp(config.arguments[4].value, "-oops") == 0);
+	free(memory);
+
+	printf("Testing rebuilding short options alone\n");
+	assert(sap_parse(config, 10, argv1, &result) == 0);
+	memcpy(arguments, config.arguments, sizeof(arguments));
+	SapConfig shortonly = config;
+	shortonly.arguments = arguments;
+	arguments[3].longopt = NULL;
+	arguments[4].longopt = NULL;
+	overrides[1].value = "added";
+	size = sap_build_argv_size(shortonly, "child", NULL, overrides + 1, 1);
+	memory = malloc(size);
+	argv = sap_build_argv(shortonly, "child", NULL, overrides + 1, 1, memory,
+		size, &argc);
+	const char *expected3[] = { "child", "--value", "value", "-a", "-a",
+		"-c", "added", "--bflag", "--", "posarg", "-x" };
+	assert(argc == 11);
+	for (int j = 0; j < argc; j++) assert(strcmp(argv[j], expected3[j]) == 0);
+	assert(sap_parse_args(shortonly, argc, argv) == 0);
+	assert(strcmp(arguments[4].value, "added") == 0);
+	overrides[1].value = "-oops"; // cannot be given without a long option
+	assert(sap_build_argv(shortonly, "child", NULL, overrides + 1, 1, memory,
+		size, NULL) == NULL);
+	free(memory);
+	FREE_ARGV(10, argv1);
+
+	printf("Rebuilding testing passed\n\n");
+}
+
+/**
+ * @brief Log of matches made by callbacks
+ */
+typedef struct Matches
+{
+	const SapArgument *args[16];
+	const char *values[16];
+	int positions[16];
+	unsigned int count;
+	unsigned int abort_at; // abort at this match
+} Matches;
+
+/**
+ * @brief Logs match into Matches, as a SapCallback
+ */
+int log_match(const SapArgument *arg, const char *value, int position,
+	void *data)
+{
+	Matches *matches = data;
+	assert(arg->set);
+	matches->args[matches->count] = arg;
+	matches->values[matches->count] = value;
+	matches->positions[matches->count] = position;
+	return ++matches->count == matches->abort_at;
+}
+
+/**
+ * @brief Tests parse callbacks with provided config
+ *
+ * @param config config
+ */
+void test_callbacks(SapConfig config)
+{
+	printf("Testing parse callbacks...\n");
+
+	SapArgument arguments[7];
+	memcpy(arguments, config.arguments, sizeof(arguments));
+	config.arguments = arguments;
+	Matches global = { .count = 0 }, own = { .count = 0 };
+	config.callback = log_match;
+	config.callback_data = &global;
+	arguments[2].callback = log_match;
+	arguments[2].callback_data = &own;
+
+	char *argv1[9];
+	copy_argv(9, argv1, "ctests", "-ab", "posarg", "--value", "one", "--",
+		"-v", "two", "three");
+	SapResult result;
+	assert(sap_parse(config, 9, argv1, &result) == 0);
+	const int args1[] = { 3, 5, 1, 2, 6 };
+	const char *values1[] = { NULL, NULL, argv1[2], argv1[4], argv1[6] };
+	const int positions1[] = { 1, 1, 2, 3, 6 };
+	assert(global.count == 5);
+	for (unsigned int m = 0; m < 5; m++)
+	{
+		assert(global.args[m] == arguments + args1[m]);
+		assert(global.values[m] == values1[m]);
+		assert(global.positions[m] == positions1[m]);
+	}
+	assert(own.count == 1 && own.values[0] == argv1[4]);
+
+	printf("Testing aborting from a callback\n");
+	global.count = 0;
+	global.abort_at = 3;
+	assert(sap_parse(config, 9, argv1, &result) == 1);
+	assert(global.count == 3);
+	assert(result.tail_argc == 0);
+	own.count = 0;
+	own.abort_at = 1; // the argument's own callback comes first
+	global.count = 0;
+	global.abort_at = 0;
+	assert(sap_parse(config, 9, argv1, &result) == 1);
+	assert(own.count == 1 && global.count == 3);
+	FREE_ARGV(9, argv1);
+
+	printf("Testing callbacks on buffers\n");
+	const char buffer[] = "ctests\0-v\0x\0posarg\0posarg2";
+	own.count = 0;
+	own.abort_at = 0;
+	global.count = 0;
+	assert(sap_parse_buffer(config, buffer, sizeof(buffer), NULL) == 0);
+	assert(global.count == 3 && own.count == 1);
+	assert(own.values[0] == buffer + 10 && own.positions[0] == 1);
+	assert(global.positions[2] == 4);
+
+	printf("Parse callbacks testing passed\n\n");
+}
+
+/**
+ * @brief Tests occurrence streams with provided config
+ *
+ * @param config config
+ */
+void test_stream(SapConfig config)
+{
+	printf("Testing occurrence streams...\n");
+
+	SapOccurrence occurrences[8];
+	SapStream stream = { .occurrences = occurrences, .capacity = 8 };
+	config.stream = &stream;
+
+	char *argv1[11];
+	copy_argv(11, argv1, "ctests", "-v", "one", "in1", "-ab", "--value",
+		"two", "in2", "extra", "--", "tail");
+	assert(sap_parse_args(config, 11, argv1) == 0);
+	const unsigned int args1[] = { 2, 1, 3, 5, 2, 6, 7 };
+	const int positions1[] = { 1, 3, 4, 4, 5, 7, 8 };
+	const char *values1[] = { argv1[2], argv1[3], NULL, NULL, argv1[6],
+		argv1[7], argv1[8] };
+	assert(stream.count == 7);
+	for (unsigned int m = 0; m < 7; m++)
+	{
+		assert(occurrences[m].arg == args1[m]);
+		assert(occurrences[m].position == positions1[m]);
+		assert(occurrences[m].value == values1[m]);
+	}
+
+	printf("Testing overflowing streams\n");
+	occurrences[3].arg = 42;
+	stream.capacity = 3; // counted in full, written in part
+	assert(sap_parse_args(config, 11, argv1) == 0);
+	assert(stream.count == 7);
+	assert(occurrences[3].arg == 42);
+	FREE_ARGV(11, argv1);
+
+	printf("Testing streams from buffers\n");
+	stream.capacity = 8;
+	const char buffer[] = "ctests\0-bb\0posarg\0--\0-v";
+	assert(sap_parse_buffer(config, buffer, sizeof(buffer), NULL) == 1);
+	assert(stream.count == 4); // found before the parse failed
+	assert(occurrences[3].arg == 6 && occurrences[3].position == 4);
+	assert(strcmp(occurrences[3].value, "-v") == 0);
+
+	printf("Occurrence stream testing passed\n\n");
+}
+
+#ifdef __linux__
+/**
+ * @brief Replaces file at path by one holding text, the way editors do
+ *
+ * @param path path of the file
+ * @param text contents of the new file
+ */
+void replace_file(const char *path, const char *text)
+{
+	char temporary[256];
+	snprintf(temporary, sizeof(temporary), "%s.new", path);
+	FILE *file = fopen(temporary, "w");
+	assert(file);
+	fputs(text, file);
+	fclose(file);
+	assert(rename(temporary, path) == 0);
+}
+
+/**
+ * @brief Callback for sap_reload_poll() in test_reload(), logging arguments
+ * changed
+ */
+void log_change(unsigned int i, const SapArgument *old, const SapArgument *now,
+	void *data)
+{
+	assert(old != now);
+	Matches *changes = data;
+	changes->args[changes->count] = now;
+	changes->positions[changes->count++] = i;
+}
+#endif
+
+/**
+ * @brief Tests reloading files of options with provided config
+ *
+ * @param config config
+ */
+void test_reload(SapConfig config)
+{
+#ifdef __linux__
+	printf("Testing reloads...\n");
+
+	char directory[] = "/tmp/saptestsXXXXXX";
+	assert(mkdtemp(directory));
+	char path[256];
+	snprintf(path, sizeof(path), "%s/options", directory);
+	replace_file(path, "# daemon options\n-v one -a\nin1 in2\n");
+
+	Matches changes = { 0 };
+	SapReloader reloader;
+	assert(sap_reload_init(&reloader, config, path, log_change, &changes)
+		== 0);
+	const SapSnapshot *first = sap_reload_acquire(&reloader);
+	assert(first->generation == 1 && first->argcount == config.argcount);
+	assert(strcmp(first->arguments[2].value, "one") == 0);
+	assert(first->arguments[3].count == 1 && !first->arguments[5].set);
+	assert(strcmp(first->arguments[6].value, "in2") == 0);
+	assert(sap_reload_poll(&reloader) == 0 && changes.count == 0);
+
+	printf("Testing changed arguments\n");
+	replace_file(path, "-v two -a -a\nin1 in2 # same positionals\n");
+	assert(sap_reload_poll(&reloader) == 0);
+	assert(changes.count == 2);
+	assert(changes.positions[0] == 2 && changes.positions[1] == 3);
+	const SapSnapshot *second = sap_reload_acquire(&reloader);
+	assert(changes.args[0] == &second->arguments[2]);
+	assert(second->generation == 2);
+	assert(strcmp(second->arguments[2].value, "two") == 0);
+	assert(second->arguments[3].count == 2);
+	assert(strcmp(first->arguments[2].value, "one") == 0); // still held
+
+	printf("Testing invalid files\n");
+	replace_file(path, "-v three\n"); // positionals missing
+	assert(sap_reload_poll(&reloader) == 1);
+	assert(changes.count == 2);
+	const SapSnapshot *current = sap_reload_acquire(&reloader);
+	assert(current == second);
+	sap_reload_release(current);
+
+	printf("Testing held snapshots\n");
+	replace_file(path, "-v three in1 in2\n");
+	assert(sap_reload_poll(&reloader) == 0);
+	const SapSnapshot *third = sap_reload_acquire(&reloader);
+	replace_file(path, "-v four in1 in2\n");
+	assert(sap_reload_poll(&reloader) == 0);
+	const SapSnapshot *fourth = sap_reload_acquire(&reloader);
+	assert(fourth->generation == 4 && changes.count == 5);
+	replace_file(path, "-v five in1 in2\n");
+	assert(sap_reload_poll(&reloader) == 1); // every slot is held
+	sap_reload_release(first);
+	assert(sap_reload_poll(&reloader) == 0); // left pending until now
+	current = sap_reload_acquire(&reloader);
+	assert(current->generation == 5);
+	assert(strcmp(current->arguments[2].value, "five") == 0);
+	assert(strcmp(second->arguments[2].value, "two") == 0);
+	sap_reload_release(current);
+	sap_reload_release(second);
+	sap_reload_release(third);
+	sap_reload_release(fourth);
+
+	sap_reload_free(&reloader);
+	assert(unlink(path) == 0 && rmdir(directory) == 0);
+	printf("Reload testing passed\n\n");
+#else
+	(void) config;
+#endif
+}
+
+/**
+ * @brief Tests copying values into arenas with provided config
+ *
+ * @param config config
+ */
+void test_arena(SapConfig config)
+{
+	printf("Testing value arenas...\n");
+
+	void *memory[16]; // aligned for pointers
+	SapArena arena = { .memory = memory, .size = sizeof(memory) };
+	SapOccurrence occurrences[8];
+	SapStream stream = { .occurrences = occurrences, .capacity = 8 };
+	config.arena = &arena;
+	config.stream = &stream;
+
+	printf("Testing recycled buffers\n");
+	char buffer[] = "ctests\0-v\0one\0-v\0two\0in1\0-a\0in2\0--\0t1\0t2";
+	SapResult result;
+	assert(sap_parse_buffer(config, buffer, sizeof(buffer), &result) == 0);
+	assert(arena.used == 6 + 4 * 4 && stream.count == 5);
+	memset(buffer, 'x', sizeof(buffer));
+	assert(strcmp(config.arguments[2].value, "two") == 0);
+	assert(strcmp(config.arguments[1].value, "in1") == 0);
+	assert(strcmp(config.arguments[6].value, "in2") == 0);
+	assert(result.tail_argc == 2 && result.tail_size == 6);
+	assert(memcmp(result.tail_buffer, "t1\0t2", 6) == 0);
+	assert(strcmp(occurrences[0].value, "one") == 0);
+	assert(occurrences[1].value == config.arguments[2].value); // shared
+	assert(occurrences[3].value == NULL);
+	config.stream = NULL;
+
+	printf("Testing arenas too small\n");
+	arena.size = 8;
+	const char small[] = "ctests\0-v\0one\0in1\0in2";
+	assert(sap_parse_buffer(config, small, sizeof(small), NULL) == 1);
+	assert(arena.used == 12);
+	assert(config.arguments[2].value == small + 10); // left in place
+
+	printf("Testing growing arenas\n");
+	SapArena grown = { .grow = 1 };
+	config.arena = &grown;
+	char *argv1[7];
+	copy_argv(7, argv1, "ctests", "-v", "value", "posarg", "posarg2",
+		"--", "child");
+	assert(sap_parse(config, 7, argv1, &result) == 0);
+	FREE_ARGV(7, argv1);
+	assert(grown.memory && grown.size == grown.used);
+	assert(strcmp(config.arguments[2].value, "value") == 0);
+	assert(strcmp(config.arguments[6].value, "posarg2") == 0);
+	assert(result.tail_argc == 1 && strcmp(result.tail_argv[0], "child") == 0);
+	assert(result.tail_argv[1] == NULL);
+
+	printf("Testing arenas through caches\n");
+	SapCache cache;
+	size_t size = sap_cache_size(config, 2, 64);
+	void *cachememory = malloc(size);
+	assert(sap_cache_init(&cache, config, cachememory, size, 2, 64) == 0);
+	for (int k = 0; k < 2; k++) // missed, then hit
+	{
+		char *argv2[6];
+		copy_argv(6, argv2, "ctests", "-a", "-v", "value", "posarg",
+			"posarg2");
+		assert(sap_cache_parse(&cache, 6, argv2, NULL) == 0);
+		FREE_ARGV(6, argv2);
+		assert(strcmp(config.arguments[2].value, "value") == 0);
+		assert(strcmp(config.arguments[1].value, "posarg") == 0);
+	}
+	assert(cache.misses == 1 && cache.hits == 1);
+	free(cachememory);
+	free(grown.memory);
+
+	printf("Value arena testing passed\n\n");
+}
+
+/**
+ * @brief Checks sap_parse_parallel() leaves the same results as sap_parse()
+ *
+ * @param config config, with a stream
+ * @param argc argument count
+ * @param argv argument values
+ * @param threads number of threads
+ */
+void check_parallel(SapConfig config, int argc, char **argv,
+	unsigned int threads)
+{
+	SapArgument serial[7];
+	SapOccurrence occurrences[64];
+	SapResult result, expected;
+	int status = sap_parse(config, argc, argv, &expected);
+	memcpy(serial, config.arguments, sizeof(serial));
+	unsigned int count = config.stream->count;
+	memcpy(occurrences, config.stream->occurrences, sizeof(occurrences));
+
+	size_t size = sap_parse_parallel_size(argc);
+	void *memory = malloc(size);
+	assert(sap_parse_parallel(config, argc, argv, NULL, threads, memory,
+		size - 1) == 1);
+	assert(sap_parse_parallel(config, argc, argv, &result, threads, memory,
+		size) == status);
+	free(memory);
+	for (unsigned int i = 0; i < 7; i++)
+	{
+		const SapArgument *arg = config.arguments + i;
+		assert(arg->set == serial[i].set && arg->count == serial[i].count);
+		if (arg->set) assert(arg->value == serial[i].value);
+		if (arg->set && arg->choicecount)
+			assert(arg->choice == serial[i].choice);
+	}
+	assert(config.stream->count == count);
+	assert(memcmp(occurrences, config.stream->occurrences,
+		sizeof(SapOccurrence) * (count < 64 ? count : 64)) == 0);
+	assert(result.tail_argc == expected.tail_argc);
+	assert(result.tail_argv == expected.tail_argv);
+}
+
+/**
+ * @brief Tests parsing on several threads with provided config
+ *
+ * @param config config
+ */
+void test_parallel(SapConfig config)
+{
+	printf("Testing parallel parsing...\n");
+
+	SapArgument arguments[7];
+	memcpy(arguments, config.arguments, sizeof(arguments));
+	const char *choices[] = { "x", "y" };
+	arguments[4].choices = choices;
+	arguments[4].choicecount = 2;
+	config.arguments = arguments;
+	SapOccurrence occurrences[64];
+	SapStream stream = { .occurrences = occurrences, .capacity = 64 };
+	config.stream = &stream;
+
+	printf("Testing random command lines\n");
+	const char *pool[] = { "-a", "-b", "-ab", "--aflag", "-v", "val",
+		"--cvalue", "x", "z", "path", "--unknown", "-c", "y", "--", "-5",
+		"--cvalue=y", "--cvalue=z", "--value=v", "--aflag=on" };
+	char *argv1[40];
+	unsigned int seed = 1;
+	argv1[0] = "ctests";
+	for (int line = 0; line < 500; line++)
+	{
+		int argc = 1 + line % 39;
+		for (int j = 1; j < argc; j++)
+		{
+			seed = seed * 1103515245 + 12345;
+			argv1[j] = (char *) pool[(seed >> 16) % 19];
+		}
+		for (unsigned int threads = 1; threads < 6; threads++)
+			check_parallel(config, argc, argv1, threads);
+	}
+
+	printf("Testing long command lines\n");
+	int argc = 70001;
+	char **argv2 = malloc(sizeof(char *) * argc);
+	const char *cycle[] = { "-v", "val", "path", "-ab", "--cvalue", "y",
+		"--aflag" };
+	argv2[0] = "ctests";
+	for (int j = 1; j < argc; j++)
+		argv2[j] = (char *) cycle[(j - 1) % 7];
+	argv2[argc - 2] = "--";
+	for (unsigned int threads = 1; threads < 9; threads++)
+		check_parallel(config, argc, argv2, threads);
+	assert(arguments[3].count == 2 * 10000 - 1);
+	free(argv2);
+
+	printf("Parallel parsing testing passed\n\n");
+}
+
+/**
+ * @brief Tests scanning of long options of every length at every alignment
+ */
+void test_scanning()
+{
+	printf("Testing token scanning...\n");
+
+	char name[80];
+	SapArgument argument = { .longopt = name, .type = SAP_ARG_OPTION_VALUE };
+	SapConfig config = { .name = "scan", .arguments = &argument,
+		.argcount = 1 };
+	SapConfig compiled = config;
+	size_t size = sap_compile_size(config);
+	void *memory = malloc(size);
+	assert(sap_compile(&compiled, memory, size) == 0);
+
+	// blocks of 64 bytes cover the widest reads from any alignment
+	_Alignas(64) char block[256];
+	for (unsigned int length = 1; length < 70; length++)
+	{
+		memset(name, 'n', length);
+		name[length] = '\0';
+		assert(sap_compile(&compiled, memory, size) == 0);
+		for (unsigned int offset = 0; offset < 64; offset++)
+		{
+			char *token = block + offset;
+			char *argv[3] = { "scan", token, NULL };
+			SapConfig *configs[] = { &config, &compiled };
+			for (unsigned int c = 0; c < 2; c++)
+			{
+				memset(block, '=', sizeof(block)); // after every NUL
+				snprintf(token, 160, "--%s=v", name);
+				assert(sap_parse_args(*configs[c], 2, argv) == 0);
+				assert(argument.value == token + 3 + length);
+				token[3 + length] = '\0'; // --name= with nothing after
+				assert(sap_parse_args(*configs[c], 2, argv) == 0);
+				assert(argument.value[0] == '\0');
+				token[2 + length] = '\0'; // --name, its value missing
+				assert(sap_parse_args(*configs[c], 2, argv) != 0);
+				token[2 + length] = 'x'; // --namex=, not ours
+				assert(sap_parse_args(*configs[c], 2, argv) == 0);
+				assert(!argument.set);
+			}
+		}
+	}
+	free(memory);
+
+	printf("Token scanning testing passed\n\n");
+}
+
+/**
+ * @brief Message written by sap_write_error()
+ */
+typedef struct Message
+{
+	char text[1024];
+	size_t size;
+} Message;
+
+/**
+ * @brief Appends text to Message, as a SapWriteCallback
+ */
+void write_message(const char *text, size_t size, void *data)
+{
+	Message *message = data;
+	assert(message->size + size < sizeof(message->text));
+	memcpy(message->text + message->size, text, size);
+	message->size += size;
+	message->text[message->size] = '\0';
+}
+
+/**
+ * @brief Checks that argv fails to parse with the error given, compiled or
+ * not, in parallel and from a buffer, and is described by message
+ *
+ * @param config config, not compiled
+ * @param argc length of argv
+ * @param argv tokens to parse
+ * @param kind kind of error expected
+ * @param token index of token expected
+ * @param text offset into argv[token] of text expected, -1 if NULL
+ * @param arg index of argument expected
+ * @param message message expected
+ */
+void check_error(SapConfig config, int argc, char **argv, SapErrorKind kind,
+	int token, int text, int arg, const char *message)
+{
+	SapConfig compiled = config;
+	size_t size = sap_compile_size(config);
+	void *memory = malloc(size);
+	assert(sap_compile(&compiled, memory, size) == 0);
+	size_t parallelsize = sap_parse_parallel_size(argc);
+	void *parallel = malloc(parallelsize);
+	char buffer[256];
+	size_t buffersize = 0;
+	for (int j = 0; j < argc; j++)
+	{
+		size_t length = strlen(argv[j]) + 1;
+		memcpy(buffer + buffersize, argv[j], length);
+		buffersize += length;
+	}
+
+	for (unsigned int way = 0; way < 4; way++)
+	{
+		SapResult result;
+		memset(&result, 0xFF, sizeof(result));
+		int status = way == 0 ? sap_parse(config, argc, argv, &result)
+			: way == 1 ? sap_parse(compiled, argc, argv, &result)
+			: way == 2 ? sap_parse_parallel(compiled, argc, argv, &result, 2,
+				parallel, parallelsize)
+			: sap_parse_buffer(config, buffer, buffersize, &result);
+		assert(status == (kind != SAP_ERROR_NONE));
+		assert(result.error.kind == kind);
+		assert(result.error.token == token);
+		assert(result.error.arg == arg);
+		if (text < 0) assert(result.error.text == NULL);
+		else if (way < 3) assert(result.error.text == argv[token] + text);
+		else assert(strcmp(result.error.text, argv[token] + text) == 0);
+
+		Message written = { .size = 0 };
+		sap_write_error(config, &result.error, write_message, &written);
+		assert(strcmp(written.text, message) == 0);
+	}
+	free(parallel);
+	free(memory);
+}
+
+/**
+ * @brief Rejects the argument data points to, as a SapCallback
+ */
+int reject_arg(const SapArgument *arg, const char *value, int position,
+	void *data)
+{
+	(void) value;
+	(void) position;
+	return arg == data;
+}
+
+/**
+ * @brief Tests errors of failed parses with provided config
+ *
+ * @param config config
+ */
+void test_errors(SapConfig config)
+{
+	printf("Testing parse errors...\n");
+
+	SapArgument arguments[7];
+	memcpy(arguments, config.arguments, sizeof(arguments));
+	config.arguments = arguments;
+	const char *colours[] = { "red", "green" };
+	arguments[4].choices = colours;
+	arguments[4].choicecount = 2;
+
+	char *argv1[6];
+	copy_argv(6, argv1, "ctests", "-v", "x", "p1", "-a", "p2");
+	check_error(config, 6, argv1, SAP_ERROR_NONE, -1, -1, -1, "");
+	strcpy(argv1[4], "-=");
+	check_error(config, 6, argv1, SAP_ERROR_MALFORMED, 4, 0, -1,
+		"ctests: malformed option '-='\n");
+	strcpy(argv1[4], "-x"); // ignored unless strict
+	check_error(config, 6, argv1, SAP_ERROR_NONE, -1, -1, -1, "");
+	unsigned int permissive = config.flags;
+	config.flags |= SAP_FLAG_STRICT;
+	check_error(config, 6, argv1, SAP_ERROR_UNKNOWN, 4, 0, -1,
+		"ctests: unknown option '-x'\n");
+	char *argv9[5];
+	copy_argv(5, argv9, "ctests", "p1", "--nope", "-a", "p2");
+	check_error(config, 5, argv9, SAP_ERROR_UNKNOWN, 2, 0, -1,
+		"ctests: unknown option '--nope'\n");
+	FREE_ARGV(5, argv9);
+	config.flags = permissive;
+	char *argv2[4];
+	copy_argv(4, argv2, "ctests", "p1", "p2", "-v");
+	check_error(config, 4, argv2, SAP_ERROR_MISSING_VALUE, 3, 0, 2,
+		"ctests: missing value for --value\n");
+	char *argv3[5];
+	copy_argv(5, argv3, "ctests", "-av", "x", "p1", "p2");
+	check_error(config, 5, argv3, SAP_ERROR_CLUSTER, 1, 0, 2,
+		"ctests: --value takes a value and must be given alone, not in "
+		"'-av'\n");
+	char *argv4[6];
+	copy_argv(6, argv4, "ctests", "p1", "--aflag=x", "-v", "x", "p2");
+	check_error(config, 6, argv4, SAP_ERROR_UNWANTED_VALUE, 2, 0, 3,
+		"ctests: --aflag takes no value, given '--aflag=x'\n");
+	char *argv5[7];
+	copy_argv(7, argv5, "ctests", "-v", "x", "-c", "blue", "p1", "p2");
+	check_error(config, 7, argv5, SAP_ERROR_CHOICE, 4, 0, 4,
+		"ctests: invalid value 'blue' for --cvalue\n");
+	char *argv6[6];
+	copy_argv(6, argv6, "ctests", "-v", "x", "--cvalue=blue", "p1", "p2");
+	check_error(config, 6, argv6, SAP_ERROR_CHOICE, 3, 9, 4,
+		"ctests: invalid value 'blue' for --cvalue\n");
+
+	printf("Testing missing arguments\n");
+	check_error(config, 3, argv2, SAP_ERROR_REQUIRED, -1, -1, 2,
+		"ctests: missing --value\n");
+	check_error(config, 4, argv1, SAP_ERROR_REQUIRED, -1, -1, 6,
+		"ctests: missing ANOTHERPOSARG\n");
+
+	printf("Testing callbacks aborting\n");
+	char *argv8[5];
+	copy_argv(5, argv8, "ctests", "-v", "x", "p1", "p2");
+	config.callback = reject_arg;
+	config.callback_data = arguments + 6;
+	check_error(config, 5, argv8, SAP_ERROR_CALLBACK, 4, 0, 6,
+		"ctests: rejected ANOTHERPOSARG\n");
+	config.callback = NULL;
+
+	printf("Testing broken rules\n");
+	const unsigned int flags[] = { 3, 5 };
+	SapRule rules[] =
+	{
+		{ .type = SAP_RULE_CONFLICTS, .arg = 3, .group = flags + 1,
+			.groupcount = 1 },
+		{ .type = SAP_RULE_EXACTLY_ONE, .group = flags, .groupcount = 2 }
+	};
+	config.rules = rules;
+	config.rulecount = 2;
+	char *argv7[6];
+	copy_argv(6, argv7, "ctests", "-v", "x", "-ab", "p1", "p2");
+	check_error(config, 6, argv7, SAP_ERROR_RULE, -1, -1, 5,
+		"ctests: --aflag may not be given with --bflag\n");
+	SapResult result;
+	assert(sap_parse(config, 6, argv7, &result) == 1);
+	assert(result.error.rule == 0);
+	FREE_ARGV(6, argv7);
+	copy_argv(6, argv7, "ctests", "-v", "x", "p1", "p2", "--");
+	check_error(config, 6, argv7, SAP_ERROR_RULE, -1, -1, -1,
+		"ctests: exactly one of --aflag, --bflag must be given\n");
+	assert(sap_parse(config, 6, argv7, &result) == 1);
+	assert(result.error.rule == 1);
+	rules[1].group = (const unsigned int[]) { 3, 9 };
+	assert(sap_parse(config, 6, argv7, &result) == 1);
+	assert(result.error.kind == SAP_ERROR_CONFIG && result.error.rule == -1);
+	config.rulecount = 0;
+
+	printf("Testing memory too small\n");
+	assert(sap_parse_parallel(config, 6, argv1, &result, 1, NULL, 0) == 1);
+	assert(result.error.kind == SAP_ERROR_MEMORY);
+	void *memory[1];
+	SapArena arena = { .memory = memory, .size = sizeof(memory) };
+	config.arena = &arena;
+	assert(sap_parse(config, 6, argv5, &result) == 1);
+	assert(result.error.kind == SAP_ERROR_CHOICE); // the first error
+	FREE_ARGV(6, argv6);
+	copy_argv(6, argv6, "ctests", "-v", "x", "--cvalue=red", "p1", "p2");
+	assert(sap_parse(config, 6, argv6, &result) == 1);
+	assert(result.error.kind == SAP_ERROR_MEMORY);
+	config.arena = NULL;
+
+	printf("Testing errors through the cache\n");
+	size_t size = sap_cache_size(config, 2, 64);
+	void *cachememory = malloc(size);
+	SapCache cache;
+	assert(sap_cache_init(&cache, config, cachememory, size, 2, 64) == 0);
+	assert(sap_cache_parse(&cache, 6, argv6, &result) == 0);
+	assert(sap_cache_parse(&cache, 4, argv2, &result) == 1);
+	assert(result.error.kind == SAP_ERROR_MISSING_VALUE);
+	assert(sap_cache_parse(&cache, 6, argv6, &result) == 0);
+	assert(cache.hits == 1 && result.error.kind == SAP_ERROR_NONE);
+	free(cachememory);
+
+	FREE_ARGV(6, argv1);
+	FREE_ARGV(4, argv2);
+	FREE_ARGV(5, argv3);
+	FREE_ARGV(6, argv4);
+	FREE_ARGV(7, argv5);
+	FREE_ARGV(6, argv6);
+	FREE_ARGV(6, argv7);
+	FREE_ARGV(5, argv8);
+
+	printf("Parse error testing passed\n\n");
+}
+
+/**
+ * @brief Tests help by section and by keyword with provided config
+ *
+ * @param config config
+ */
+void test_help_index(SapConfig config)
+{
+	printf("Testing help index...\n");
+
+	SapArgument arguments[7];
+	memcpy(arguments, config.arguments, sizeof(arguments));
+	config.arguments = arguments;
+	const char *sections[] = { "General", "Values" };
+	config.sections = sections;
+	config.sectioncount = 2;
+	arguments[2].section = 1;
+	arguments[4].section = 1;
+	arguments[3].help = "Flag A, the flag"; // repeated word
+	arguments[5].longopt = "b-flag"; // several words
+
+	size_t size = sap_help_index_size(config);
+	void *memory = malloc(size);
+	SapHelpIndex index;
+	assert(sap_help_index_init(&index, config, memory, size - 1) != 0);
+	assert(sap_help_index_init(&index, config, memory, size) == 0);
+
+	printf("Testing sections\n");
+	Message message = { .size = 0 };
+	assert(sap_write_help_section(&index, "Values", write_message,
+		&message) == 0);
+	assert(strcmp(message.text, "Values:\n"
+		"\t-v, --value A valued option\n"
+		"\t-c, --cvalue Another valued option\n") == 0);
+	message.size = 0;
+	assert(sap_write_help_section(&index, "General", write_message,
+		&message) == 0);
+	assert(strcmp(message.text, "General:\n"
+		"\t-h, --help Prints this help message\n"
+		"\t-a, --aflag Flag A, the flag\n"
+		"\t-b, --b-flag Flag B\n") == 0);
+	assert(sap_write_help_section(&index, "values", write_message,
+		&message) == 1);
+
+	printf("Testing keywords\n");
+	message.size = 0;
+	assert(sap_write_help_keyword(&index, "FLAG", write_message,
+		&message) == 2); // each argument once
+	assert(strcmp(message.text, "\t-a, --aflag Flag A, the flag\n"
+		"\t-b, --b-flag Flag B\n") == 0);
+	message.size = 0;
+	assert(sap_write_help_keyword(&index, "another", write_message,
+		&message) == 2);
+	assert(strcmp(message.text, "\t-c, --cvalue Another valued option\n"
+		"\tANOTHERPOSARG Positional another time\n") == 0);
+	message.size = 0;
+	assert(sap_write_help_keyword(&index, "--b-flag", write_message,
+		&message) == 1);
+	assert(strcmp(message.text, "\t-b, --b-flag Flag B\n") == 0);
+	assert(sap_write_help_keyword(&index, "b", write_message,
+		&message) == 1);
+	assert(sap_write_help_keyword(&index, "val", write_message,
+		&message) == 0);
+	assert(sap_write_help_keyword(&index, "", write_message,
+		&message) == 0);
+
+	printf("Testing full help under sections\n");
+	message.size = 0;
+	sap_write_help(config, write_message, &message);
+	assert(strstr(message.text, "\n\nGeneral:\n\t-h, --help"));
+	assert(strstr(message.text, "\n\nValues:\n"
+		"\t-v, --value A valued option\n"
+		"\t-c, --cvalue Another valued option\n\nARGUMENTS:\n"));
+	assert(!strstr(message.text, "FLAGS:"));
+
+	printf("Testing options in nonexistent sections\n");
+	arguments[0].section = 2;
+	assert(sap_help_index_init(&index, config, memory, size) != 0);
+	config.sectioncount = 0; // sections ignored without any
+	assert(sap_help_index_init(&index, config, memory, size) == 0);
+	assert(sap_write_help_section(&index, "General", write_message,
+		&message) == 1);
+	assert(sap_write_help_keyword(&index, "positional", write_message,
+		&message) == 2);
+	free(memory);
+
+	printf("Help index testing passed\n\n");
+}
+
 int main()
 {
 	// create config
@@ -314,6 +2289,26 @@ int main()
 	test_value(config);
 	test_opt(config);
 	test_pos(config);
+	test_incremental(config);
+	test_rules(config);
+	test_defaults(config);
+	test_classification(config);
+	test_tail(config);
+	test_large();
+	test_registry(config);
+	test_count(config);
+	test_cache(config);
+	test_buffer(config);
+	test_choices(config);
+	test_build(config);
+	test_callbacks(config);
+	test_stream(config);
+	test_reload(config);
+	test_arena(config);
+	test_parallel(config);
+	test_scanning();
+	test_errors(config);
+	test_help_index(config);
 
 	// free config memory
 	free(config.arguments);
@@ -0,0 +1,186 @@
+/**
+ * @file freetests.c
+ * @brief Tests of the freestanding configuration, without the C library
+ */
+
+// implementation first, so that any use of the C library by it fails to
+// compile
+#define SAP_FREESTANDING
+#define SAP_IMPLEMENTATION
+#include "sap.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Buffer help message is written into
+ */
+typedef struct Buffer
+{
+	char text[1024];
+	size_t size;
+} Buffer;
+
+/**
+ * @brief Appends text to buffer, as a SapWriteCallback
+ */
+void write_buffer(const char *text, size_t size, void *data)
+{
+	Buffer *buffer = data;
+	assert(buffer->size + size < sizeof(buffer->text));
+	memcpy(buffer->text + buffer->size, text, size);
+	buffer->size += size;
+	buffer->text[buffer->size] = '\0';
+}
+
+/**
+ * @brief Tests string primitives against the C library
+ */
+void test_primitives()
+{
+	printf("Testing string primitives...\n");
+
+	const char *strings[] = { "", "a", "ab", "abc", "abd", "b", "\xff" };
+	for (unsigned int i = 0; i < 7; i++)
+	{
+		assert(_sap_strlen(strings[i]) == strlen(strings[i]));
+		for (unsigned int j = 0; j < 7; j++)
+		{
+			int a = _sap_strcmp(strings[i], strings[j]);
+			int b = strcmp(strings[i], strings[j]);
+			assert((a < 0) == (b < 0) && (a > 0) == (b > 0));
+			for (size_t n = 0; n < 4; n++)
+			{
+				a = _sap_strncmp(strings[i], strings[j], n);
+				b = strncmp(strings[i], strings[j], n);
+				assert((a < 0) == (b < 0) && (a > 0) == (b > 0));
+			}
+		}
+	}
+
+	char buffer[16] = "0123456789";
+	_sap_memmove(buffer + 2, buffer, 8); // overlapping forwards
+	assert(_sap_memcmp(buffer, "0101234567", 10) == 0);
+	_sap_memmove(buffer, buffer + 2, 8); // overlapping backwards
+	assert(_sap_memcmp(buffer, "0123456767", 10) == 0);
+	_sap_memset(buffer, 'x', 3);
+	_sap_memcpy(buffer + 3, "yz", 2);
+	assert(memcmp(buffer, "xxxyz56767", 10) == 0);
+	assert(_sap_memcmp("ab", "ac", 2) < 0 && _sap_memcmp("ab", "ac", 1) == 0);
+
+	printf("String primitives testing passed\n\n");
+}
+
+/**
+ * @brief Tests conversion to integers against strtol(), failing where it
+ * is out of range
+ */
+void test_long()
+{
+	printf("Testing integer conversion...\n");
+
+	const char *values[] = { "0", "42", "-42", "+7", " 12", "0x1f", "0X1F",
+		"-0x10", "017", "08", "0x", "12a", "-", "", "9223372036854775807",
+		"9223372036854775808", "-9223372036854775808",
+		"-9223372036854775809", "99999999999999999999999", "\t-3" };
+	for (unsigned int i = 0; i < 20; i++)
+	{
+		SapArgument arg = { .set = 1, .value = values[i] };
+		long ours = 0, theirs;
+		int status = sap_get_long(&arg, &ours);
+
+		char *end;
+		errno = 0;
+		theirs = strtol(values[i], &end, 0);
+		int expected = !*values[i] || end == values[i] || *end != '\0'
+			|| errno == ERANGE;
+		assert(status == expected);
+		if (!status) assert(ours == theirs);
+	}
+
+	printf("Integer conversion testing passed\n\n");
+}
+
+/**
+ * @brief Tests parsing and help message without stdio
+ */
+void test_parse()
+{
+	printf("Testing freestanding parsing...\n");
+
+	const char *const choices[] = { "fast", "slow" };
+	SapArgument arguments[] =
+	{
+		{
+			.shortopt = 'v',
+			.longopt = "verbose",
+			.type = SAP_ARG_OPTION,
+			.help = "Be verbose"
+		},
+		{
+			.shortopt = 's',
+			.longopt = "speed",
+			.type = SAP_ARG_OPTION_VALUE,
+			.help = "Speed",
+			.default_value = "fast",
+			.choices = choices,
+			.choicecount = 2
+		},
+		{
+			.longopt = "FILE",
+			.type = SAP_ARG_POSITIONAL,
+			.required = 1,
+			.help = "File to read"
+		}
+	};
+	SapConfig config =
+	{
+		.name = "init",
+		.version_major = 1,
+		.version_minor = 20,
+		.version_patch = 300,
+		.author = "Chua Hou",
+		.about = "Freestanding test for sap",
+		.arguments = arguments,
+		.argcount = 3
+	};
+
+	char memory[1024];
+	assert(sap_compile_size(config) <= sizeof(memory));
+	assert(sap_compile(&config, memory, sizeof(memory)) == 0);
+
+	char *argv[] = { "init", "-vv", "--speed", "slow", "file", NULL };
+	assert(sap_parse_args(config, 5, argv) == 0);
+	assert(arguments[0].count == 2);
+	assert(sap_get_choice(arguments + 1) == 1);
+	assert(arguments[2].value == argv[4]);
+	argv[3] = "medium";
+	assert(sap_parse_args(config, 5, argv) == 1);
+
+	Buffer buffer = { .size = 0 };
+	sap_write_help(config, write_buffer, &buffer);
+	assert(strcmp(buffer.text,
+		"init 1.20.300\n"
+		"Chua Hou\n"
+		"Freestanding test for sap\n\n"
+		"USAGE:\n\tinit [FLAGS] FILE \n\n"
+		"FLAGS:\n"
+		"\t-v, --verbose Be verbose\n"
+		"\t-s, --speed Speed [default: fast] [possible values: fast, slow]\n"
+		"\n"
+		"ARGUMENTS:\n"
+		"\tFILE File to read\n") == 0);
+
+	printf("Freestanding parsing testing passed\n\n");
+}
+
+int main()
+{
+	test_primitives();
+	test_long();
+	test_parse();
+	return 0;
+}
@@ -0,0 +1,706 @@
+/**
+ * @file perftests.c
+ * @brief Performance tests in C language, built optimised
+ *
+ * Checks that parse time grows linearly with the number of tokens and of
+ * arguments, that parsing never allocates, and fuzzes command lines made to
+ * be awkward for any time growing faster than their length. Writing part of
+ * the help through an index must not grow with the number of options.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sap.h"
+
+// times a command line is parsed, the fastest taken
+#define RUNS 7
+
+// most a time per token may grow by when the command line or the
+// configuration grows 16 times, which would be 16 for a quadratic parse
+#define SCALE_LIMIT 4.0
+
+// most parse time may grow by when a command line is repeated, plus slack in
+// nanoseconds for command lines that end early with an error
+#define DOUBLE_LIMIT 4.0
+#define DOUBLE_SLACK 20000.0
+
+// most time per byte of an awkward command line may be over that of a valid
+// one, so that no byte costs a search through the arguments
+#define BYTE_LIMIT 4.0
+
+#ifdef __GLIBC__
+// allocations are counted while counting is set, and handed on to glibc
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *p);
+
+int counting = 0;
+unsigned long allocations = 0;
+
+void *malloc(size_t size)
+{
+	allocations += counting;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+	allocations += counting;
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+	allocations += counting;
+	return __libc_realloc(p, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+	allocations += counting;
+	return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+	allocations += counting;
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **p, size_t alignment, size_t size)
+{
+	allocations += counting;
+	*p = __libc_memalign(alignment, size);
+	return *p ? 0 : 12; // ENOMEM
+}
+
+void free(void *p)
+{
+	__libc_free(p);
+}
+#endif
+
+/**
+ * @brief Configuration of generated options, compiled and with a bitset of
+ * arguments set
+ */
+typedef struct Generated
+{
+	SapConfig config;
+	SapArgument *arguments;
+	char (*names)[12];
+	void *memory;
+} Generated;
+
+/**
+ * @brief Generates a compiled configuration of count arguments
+ *
+ * Arguments are options o0 onwards, every third valued, with short options
+ * from a-z, and two positional arguments at the end. Each parse only clears
+ * the arguments the one before it set.
+ *
+ * @param count Number of arguments, at least 3
+ * @return Generated configuration, freed with free_generated()
+ */
+Generated generate(unsigned int count)
+{
+	Generated g;
+	g.arguments = calloc(count, sizeof(SapArgument));
+	g.names = malloc(12 * count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		snprintf(g.names[i], 12, "o%u", i);
+		g.arguments[i].longopt = g.names[i];
+		g.arguments[i].help = "Generated option";
+		g.arguments[i].type = i % 3 == 2 ? SAP_ARG_OPTION_VALUE
+			: SAP_ARG_OPTION;
+		if (i < 26) g.arguments[i].shortopt = 'a' + i;
+	}
+	g.arguments[count - 2].type = SAP_ARG_POSITIONAL;
+	g.arguments[count - 1].type = SAP_ARG_POSITIONAL;
+
+	SapConfig config = { .name = "perf", .arguments = g.arguments,
+		.argcount = count,
+		.setbits = calloc(SAP_WORDS(count), sizeof(SapWord)) };
+	size_t size = sap_compile_size(config);
+	g.memory = malloc(size);
+	assert(sap_compile(&config, g.memory, size) == 0);
+	g.config = config;
+	return g;
+}
+
+/**
+ * @brief Frees configuration made by generate()
+ *
+ * @param g Generated configuration
+ */
+void free_generated(Generated g)
+{
+	free(g.config.setbits);
+	free(g.memory);
+	free(g.names);
+	free(g.arguments);
+}
+
+/**
+ * @brief Command line held as NUL-terminated tokens in a buffer, as taken by
+ * sap_parse_buffer(), with argv pointing into it
+ */
+typedef struct Line
+{
+	int argc;
+	char **argv;
+	char *buffer;
+	size_t size;
+} Line;
+
+/**
+ * @brief Next number of a linear congruential generator
+ *
+ * @param seed State of the generator
+ * @return Pseudorandom number up to 2^31
+ */
+unsigned int next_random(unsigned long long *seed)
+{
+	*seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (unsigned int) (*seed >> 33);
+}
+
+/**
+ * @brief Points argv of line at the tokens of its buffer
+ *
+ * @param line Line with buffer, size and argc set
+ */
+void split_line(Line *line)
+{
+	line->argv = malloc((line->argc + 1) * sizeof(char *));
+	char *p = line->buffer;
+	for (int j = 0; j < line->argc; j++)
+	{
+		line->argv[j] = p;
+		p += strlen(p) + 1;
+	}
+	assert(p == line->buffer + line->size);
+	line->argv[line->argc] = NULL;
+}
+
+/**
+ * @brief Generates a valid command line for generate(count)
+ *
+ * Both positional arguments come first, followed by options picked at
+ * random, valued ones given their value after '=' or as the next token.
+ *
+ * @param count Number of arguments in the configuration
+ * @param argc Number of tokens, counting argv[0]
+ * @param seed Seed of the choice of options
+ * @return Command line, freed with free_line()
+ */
+Line valid_line(unsigned int count, int argc, unsigned long long seed)
+{
+	Line line = { .argc = argc, .buffer = malloc(16 * argc) };
+	char *p = line.buffer;
+	p += sprintf(p, "perf") + 1;
+	p += sprintf(p, "first") + 1;
+	p += sprintf(p, "second") + 1;
+	for (int j = 3; j < argc; j++)
+	{
+		unsigned int i = next_random(&seed) % (count - 2);
+		if (i % 3 != 2) p += sprintf(p, "--o%u", i) + 1;
+		else if (j + 1 < argc && next_random(&seed) % 2)
+		{
+			p += sprintf(p, "--o%u", i) + 1;
+			p += sprintf(p, "value") + 1;
+			j++;
+		}
+		else p += sprintf(p, "--o%u=value", i) + 1;
+	}
+	line.size = p - line.buffer;
+	split_line(&line);
+	return line;
+}
+
+// most bytes in a generated token
+#define TOKEN_MAX 4000
+
+/**
+ * @brief Appends s repeated to a token, as long as it fits
+ *
+ * @param token Token of TOKEN_MAX bytes and a NUL
+ * @param length Length of token so far
+ * @param s String to append
+ * @param repeat Number of times to append s
+ */
+void append(char *token, size_t *length, const char *s, unsigned int repeat)
+{
+	size_t n = strlen(s);
+	for (unsigned int r = 0; r < repeat && *length + n <= TOKEN_MAX; r++)
+	{
+		memcpy(token + *length, s, n);
+		*length += n;
+	}
+	token[*length] = '\0';
+}
+
+/**
+ * @brief Number of times a piece of a generated token is repeated, mostly
+ * once, sometimes up to a thousand
+ *
+ * @param seed State of the generator
+ * @return Number of repeats
+ */
+unsigned int repeats(unsigned long long *seed)
+{
+	return next_random(seed) % 8 ? 1 : 1 + next_random(seed) % 1000;
+}
+
+// pieces of values and of names of unknown options
+const char *pieces[] =
+	{ "value", "=", "==", "v=v", "o", "9", "-", "\xCE\xB1" };
+
+// flags among the short options
+const char *flags[] = { "a", "b", "d", "e", "g" };
+
+/**
+ * @brief Generates a value, which may be long and full of '='
+ *
+ * @param token Token of TOKEN_MAX bytes and a NUL
+ * @param length Length of token so far
+ * @param seed State of the generator
+ */
+void append_value(char *token, size_t *length, unsigned long long *seed)
+{
+	unsigned int count = 1 + next_random(seed) % 4;
+	for (unsigned int k = 0; k < count; k++)
+		append(token, length, pieces[next_random(seed) % 8], repeats(seed));
+}
+
+/**
+ * @brief Generates an awkward command line for generate(1002)
+ *
+ * Tokens are long runs of short options, valued options with long values
+ * attached or following, unknown options with long names sharing their
+ * start with known ones, and long positional tokens. A quarter of the
+ * command lines also have an invalid token somewhere.
+ *
+ * @param argc Number of tokens, counting argv[0]
+ * @param seed Seed of the tokens
+ * @return Command line, freed with free_line()
+ */
+Line awkward_line(int argc, unsigned long long seed)
+{
+	size_t capacity = 64, size = 0;
+	char *buffer = malloc(capacity);
+	int invalid = next_random(&seed) % 4 ? -1
+		: 1 + (int) (next_random(&seed) % (argc - 1));
+	int value = 0; // whether the token must be a value
+	for (int j = 0; j < argc; j++)
+	{
+		char token[TOKEN_MAX + 1];
+		size_t length = 0;
+		unsigned int i = next_random(&seed) % 999; // o0 to o998
+		token[0] = '\0';
+		if (j == 0) {} // argv[0] is never parsed
+		else if (value || j + 1 == argc)
+		{
+			append(token, &length, "v", 1); // not taken for an option
+			append_value(token, &length, &seed);
+			value = 0;
+		}
+		else if (j == invalid)
+			append(token, &length, next_random(&seed) % 2 ? "-=" : "--o1=v",
+				1);
+		else switch (next_random(&seed) % 8)
+		{
+		case 0: // flags a, b, d, e and g
+			append(token, &length, "-", 1);
+			for (unsigned int k = 1 + next_random(&seed) % 4; k > 0; k--)
+				append(token, &length, flags[next_random(&seed) % 5],
+					repeats(&seed));
+			break;
+		case 1: // valued option c
+			append(token, &length, "-c", 1);
+			value = 1;
+			break;
+		case 2: // long flag
+			length = sprintf(token, "--o%u", i - i % 3);
+			break;
+		case 3: // long valued option with value attached
+			length = sprintf(token, "--o%u=", i - i % 3 + 2);
+			append_value(token, &length, &seed);
+			break;
+		case 4: // long valued option followed by value
+			length = sprintf(token, "--o%u", i - i % 3 + 2);
+			value = 1;
+			break;
+		case 5: // unknown long option, maybe with a value
+			length = sprintf(token, "--o%u", i + 2000);
+			append_value(token, &length, &seed);
+			break;
+		case 6: // unknown short options
+			append(token, &length, "-\xCE\xB1", 1);
+			append(token, &length, "\xCE\xB2", repeats(&seed));
+			break;
+		case 7: // positional
+			append(token, &length, "p", 1);
+			append_value(token, &length, &seed);
+			break;
+		}
+		length++;
+
+		if (size + length > capacity)
+		{
+			while (size + length > capacity) capacity *= 2;
+			buffer = realloc(buffer, capacity);
+		}
+		memcpy(buffer + size, token, length);
+		size += length;
+	}
+	Line line = { .argc = argc, .buffer = buffer, .size = size };
+	split_line(&line);
+	return line;
+}
+
+/**
+ * @brief Repeats the tokens of a command line after argv[0]
+ *
+ * @param line Command line
+ * @return Command line twice as long, freed with free_line()
+ */
+Line double_line(Line line)
+{
+	size_t first = strlen(line.buffer) + 1;
+	Line doubled = { .argc = 2 * line.argc - 1,
+		.buffer = malloc(2 * line.size - first),
+		.size = 2 * line.size - first };
+	memcpy(doubled.buffer, line.buffer, line.size);
+	memcpy(doubled.buffer + line.size, line.buffer + first,
+		line.size - first);
+	split_line(&doubled);
+	return doubled;
+}
+
+/**
+ * @brief Frees command line
+ *
+ * @param line Command line
+ */
+void free_line(Line line)
+{
+	free(line.argv);
+	free(line.buffer);
+}
+
+/**
+ * @brief Times parses of a command line
+ *
+ * @param config The SapConfig to parse with
+ * @param line Command line
+ * @param buffer Whether to parse with sap_parse_buffer() instead of
+ * sap_parse()
+ * @param status Where to store the status of the parse, may be NULL
+ * @return Nanoseconds taken by the fastest of RUNS parses
+ */
+double time_parse(SapConfig config, Line line, int buffer, int *status)
+{
+	double best = 0;
+	for (int r = 0; r < RUNS; r++)
+	{
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		int s = buffer ? sap_parse_buffer(config, line.buffer, line.size, NULL)
+			: sap_parse(config, line.argc, line.argv, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double ns = (end.tv_sec - start.tv_sec) * 1e9
+			+ (end.tv_nsec - start.tv_nsec);
+		if (r == 0 || ns < best) best = ns;
+		if (status) *status = s;
+	}
+	return best;
+}
+
+/**
+ * @brief Test that parse time grows linearly with the command line and the
+ * configuration, whether compiled or built up in a registry
+ */
+void test_scaling()
+{
+	printf("Testing parse time against number of tokens...\n");
+	Generated g = generate(64);
+	for (int buffer = 0; buffer < 2; buffer++)
+	{
+		Line small = valid_line(64, 1 << 12, 1);
+		Line large = valid_line(64, 1 << 16, 1);
+		int status;
+		double smallns = time_parse(g.config, small, buffer, &status)
+			/ small.argc;
+		assert(status == 0);
+		double largens = time_parse(g.config, large, buffer, &status)
+			/ large.argc;
+		assert(status == 0);
+		printf("%s: %.1f ns per token for %d tokens, %.1f for %d\n",
+			buffer ? "sap_parse_buffer" : "sap_parse", smallns, small.argc,
+			largens, large.argc);
+		assert(largens < SCALE_LIMIT * smallns);
+		free_line(small);
+		free_line(large);
+	}
+	free_generated(g);
+
+	printf("Testing parse time against number of arguments...\n");
+	Generated few = generate(16), many = generate(4096);
+	Line fewline = valid_line(16, 1 << 16, 2);
+	Line manyline = valid_line(4096, 1 << 16, 2);
+	int status;
+	double fewns = time_parse(few.config, fewline, 0, &status)
+		/ fewline.argc;
+	assert(status == 0);
+	double manyns = time_parse(many.config, manyline, 0, &status)
+		/ manyline.argc;
+	assert(status == 0);
+	printf("%.1f ns per token for %u arguments, %.1f for %u\n", fewns,
+		few.config.argcount, manyns, many.config.argcount);
+	assert(manyns < SCALE_LIMIT * fewns);
+
+	// a registry keeps its configuration compiled as arguments are added
+	SapRegistry registry;
+	assert(sap_registry_init(&registry, many.config) == 0);
+	double registryns = time_parse(registry.config, manyline, 0, &status)
+		/ manyline.argc;
+	assert(status == 0);
+	printf("%.1f ns per token for %u arguments added to a registry\n",
+		registryns, registry.config.argcount);
+	assert(registryns < SCALE_LIMIT * fewns);
+	sap_registry_free(&registry);
+	free_line(fewline);
+	free_line(manyline);
+	free_generated(few);
+	free_generated(many);
+
+	printf("Scaling testing passed\n\n");
+}
+
+/**
+ * @brief Test that parsing with caller memory allocates nothing
+ */
+void test_allocations()
+{
+	printf("Testing parses without allocations...\n");
+#ifdef __GLIBC__
+	Generated g = generate(1002);
+	Line line = valid_line(1002, 1 << 12, 3);
+
+	// every feature that takes memory from the caller
+	SapOccurrence occurrences[64];
+	SapStream stream = { .occurrences = occurrences, .capacity = 64 };
+	SapArena arena = { .memory = malloc(1 << 16), .size = 1 << 16 };
+	SapConfig config = g.config;
+	config.stream = &stream;
+	config.arena = &arena;
+	size_t parallelsize = sap_parse_parallel_size(line.argc);
+	void *parallel = malloc(parallelsize);
+	size_t cachesize = sap_cache_size(g.config, 4, 1 << 16);
+	void *cachememory = malloc(cachesize);
+	SapCache cache;
+	size_t incrsize = sap_incr_size(g.config, 16);
+	void *incrmemory = malloc(incrsize);
+	SapIncremental state;
+	size_t compilesize = sap_compile_size(g.config);
+	void *compilememory = malloc(compilesize);
+	SapConfig compiled = g.config;
+	compiled.compiled = NULL;
+	SapResult result;
+
+	counting = 1;
+	assert(sap_compile(&compiled, compilememory, compilesize) == 0);
+	assert(sap_parse(config, line.argc, line.argv, &result) == 0);
+	assert(sap_parse_buffer(config, line.buffer, line.size, &result) == 0);
+	assert(sap_parse_parallel(g.config, line.argc, line.argv, &result, 1,
+		parallel, parallelsize) == 0);
+	assert(sap_cache_init(&cache, g.config, cachememory, cachesize, 4,
+		1 << 16) == 0);
+	assert(sap_cache_parse(&cache, line.argc, line.argv, &result) == 0);
+	assert(sap_cache_parse(&cache, line.argc, line.argv, &result) == 0);
+	assert(sap_incr_init(&state, g.config, incrmemory, incrsize, 16) == 0);
+	assert(sap_incr_insert(&state, 0, "first") == 0);
+	assert(sap_incr_insert(&state, 1, "--o2=value") == 0);
+	assert(sap_incr_replace(&state, 1, "--o5") == 0);
+	assert(sap_incr_remove(&state, 1) == 0);
+	counting = 0;
+	printf("%lu allocations\n", allocations);
+	assert(allocations == 0);
+
+	free(compilememory);
+	free(incrmemory);
+	free(cachememory);
+	free(parallel);
+	free(arena.memory);
+	free_line(line);
+	free_generated(g);
+#else
+	printf("Skipped, allocations are only counted with glibc\n");
+#endif
+
+	printf("Allocation testing passed\n\n");
+}
+
+/**
+ * @brief Test that parse time of awkward command lines grows linearly
+ *
+ * Each command line is timed against itself repeated, which should take
+ * twice as long, whatever it is made of, and per byte against a valid
+ * command line.
+ *
+ * @param seed Seed of the first command line
+ * @param rounds Number of command lines
+ */
+void test_fuzzing(unsigned long long seed, unsigned int rounds)
+{
+	printf("Testing parse time of %u awkward command lines from seed %llu...\n",
+		rounds, seed);
+	Generated g = generate(1002);
+	SapConfig uncompiled = g.config;
+	uncompiled.compiled = NULL;
+	Line valid = valid_line(1002, 1 << 12, 4);
+	double baseline = time_parse(g.config, valid, 0, NULL) / valid.size;
+	free_line(valid);
+	double worst = 0;
+	for (unsigned int k = 0; k < rounds; k++)
+	{
+		Line line = awkward_line(1 << 11, seed + k);
+		Line doubled = double_line(line);
+		for (int buffer = 0; buffer < 2; buffer++)
+		{
+			double ns = time_parse(g.config, line, buffer, NULL);
+			double doublens = time_parse(g.config, doubled, buffer, NULL);
+			if (doublens > DOUBLE_LIMIT * ns + DOUBLE_SLACK)
+				printf("Seed %llu: %.0f ns, %.0f ns repeated\n", seed + k,
+					ns, doublens);
+			assert(doublens <= DOUBLE_LIMIT * ns + DOUBLE_SLACK);
+			if (ns / line.size > worst) worst = ns / line.size;
+		}
+
+		// the uncompiled configuration agrees
+		int status = sap_parse(g.config, line.argc, line.argv, NULL);
+		SapArgument copy[1002];
+		memcpy(copy, g.arguments, sizeof(copy));
+		assert(sap_parse(uncompiled, line.argc, line.argv, NULL) == status);
+		for (unsigned int i = 0; i < 1002; i++)
+			assert(g.arguments[i].set == copy[i].set
+				&& g.arguments[i].value == copy[i].value);
+
+		free_line(line);
+		free_line(doubled);
+	}
+	printf("Worst %.2f ns per byte, %.2f for a valid command line\n", worst,
+		baseline);
+	assert(worst < BYTE_LIMIT * baseline);
+	free_generated(g);
+
+	printf("Fuzzing testing passed\n\n");
+}
+
+/**
+ * @brief Discards text, as a SapWriteCallback
+ */
+void discard(const char *text, size_t size, void *data)
+{
+	(void) text;
+	(void) size;
+	(*(size_t *) data)++;
+}
+
+/**
+ * @brief Times writing help of one section and of one keyword from an index
+ * of count options, in sections of 16
+ *
+ * @param count Number of arguments
+ * @param sectionns Where to store nanoseconds taken to write a section
+ * @param keywordns Where to store nanoseconds taken to write a keyword
+ */
+void time_help(unsigned int count, double *sectionns, double *keywordns)
+{
+	Generated g = generate(count);
+	char (*names)[12] = malloc(12 * (count / 16));
+	const char **sections = malloc(sizeof(char *) * (count / 16));
+	for (unsigned int s = 0; s < count / 16; s++)
+	{
+		snprintf(names[s], 12, "s%u", s);
+		sections[s] = names[s];
+	}
+	for (unsigned int i = 0; i < count; i++) g.arguments[i].section = i / 16;
+	SapConfig config = g.config;
+	config.sections = sections;
+	config.sectioncount = count / 16;
+	size_t size = sap_help_index_size(config);
+	void *memory = malloc(size);
+	SapHelpIndex index;
+	assert(sap_help_index_init(&index, config, memory, size) == 0);
+
+	// many writes per timing, each far below clock resolution
+	for (int k = 0; k < 2; k++)
+	{
+		double best = 0;
+		for (int r = 0; r < RUNS; r++)
+		{
+			size_t writes = 0;
+			struct timespec start, end;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (int n = 0; n < 1000; n++)
+				if (k == 0)
+					assert(sap_write_help_section(&index, "s7", discard,
+						&writes) == 0);
+				else
+					assert(sap_write_help_keyword(&index, "o117", discard,
+						&writes) == 1);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			double ns = ((end.tv_sec - start.tv_sec) * 1e9
+				+ (end.tv_nsec - start.tv_nsec)) / 1000;
+			if (r == 0 || ns < best) best = ns;
+		}
+		*(k == 0 ? sectionns : keywordns) = best;
+	}
+
+	free(memory);
+	free(sections);
+	free(names);
+	free_generated(g);
+}
+
+/**
+ * @brief Test that writing part of the help takes time in what is written
+ */
+void test_help()
+{
+	printf("Testing help time against number of options...\n");
+	double smallsection, smallkeyword, largesection, largekeyword;
+	time_help(1 << 10, &smallsection, &smallkeyword);
+	time_help(1 << 14, &largesection, &largekeyword);
+	printf("Section: %.0f ns for %u options, %.0f for %u\n", smallsection,
+		1 << 10, largesection, 1 << 14);
+	printf("Keyword: %.0f ns for %u options, %.0f for %u\n", smallkeyword,
+		1 << 10, largekeyword, 1 << 14);
+	assert(largesection < SCALE_LIMIT * smallsection);
+	assert(largekeyword < SCALE_LIMIT * smallkeyword);
+
+	printf("Help testing passed\n\n");
+}
+
+int main(int argc, char **argv)
+{
+	// seed and number of rounds of fuzzing can be given to search further
+	unsigned long long seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+	unsigned int rounds = argc > 2 ? strtoul(argv[2], NULL, 10) : 64;
+
+	test_scaling();
+	test_allocations();
+	test_fuzzing(seed, rounds);
+	test_help();
+
+	return 0;
+}